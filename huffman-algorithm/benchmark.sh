@@ -0,0 +1,114 @@
+#!/bin/sh
+# Usage: ./benchmark.sh [extra corpus files...] > results.jsonl
+#
+# Builds huffman.c, round-trips every corpus through every compression mode
+# and prints one JSON object per run on standard output. The "compress" and
+# "extract" members are the --json reports of the two commands (sizes,
+# MB/s, peak RSS and per-phase seconds). The phases time these calls:
+#   histogram  count_frequencies, plus the pair counts of --context
+#   tree       build_codes (create_tree, generate_codes and, past the length
+#              limit, limit_code_lengths) and the --context code lengths;
+#              on extract, rebuilding the code tables
+#   encode     the put_code loops of compress_stream (-c), the
+#              encode_*_block and compress_context_block calls (-p) and
+#              compress_adaptive (-a)
+#   decode     decompress_data (-c), the decompress_*_block calls (-p) and
+#              decompress_adaptive (-a)
+#   checksum   compute_crc32c on -p blocks
+#   read/write file I/O outside the phases above
+# Exits non-zero when any round trip fails.
+#
+# Environment: CC, CFLAGS, HUFFMAN (use a prebuilt binary instead), SIZE
+# (bytes per generated corpus, default 8 MiB), RUNS (default 3), JOBS
+# (worker threads, default all cores).
+
+set -u
+
+dir=$(cd "$(dirname "$0")" && pwd)
+root=$(dirname "$dir")
+size=${SIZE:-8388608}
+runs=${RUNS:-3}
+work=$(mktemp -d "${TMPDIR:-/tmp}/huffman-bench.XXXXXX") || exit 1
+trap 'rm -rf "$work"' EXIT INT TERM
+
+if [ -n "${HUFFMAN:-}" ]; then
+  bin=$HUFFMAN
+else
+  bin=$work/huffman
+  ${CC:-cc} ${CFLAGS:--O2} -pthread -o "$bin" "$dir/huffman.c" || exit 1
+fi
+
+jobs=
+if [ -n "${JOBS:-}" ]; then
+  jobs="-j $JOBS"
+fi
+
+fill() {
+  target=$1
+  shift
+  cat "$@" > "$work/source" 2> /dev/null
+  if [ ! -s "$work/source" ]; then
+    echo "benchmark.sh: no input for $(basename "$target")" >&2
+    return 1
+  fi
+  : > "$target"
+  while [ "$(wc -c < "$target")" -lt "$size" ]; do
+    cat "$work/source" >> "$target"
+  done
+  head -c "$size" "$target" > "$work/source" && mv "$work/source" "$target"
+}
+
+mkdir "$work/corpus"
+fill "$work/corpus/text" $(find "$root" -type f \( -name '*.c' -o \
+  -name '*.tex' -o -name '*.html' -o -name '*.js' -o -name '*.R' -o \
+  -name '*.cnf' -o -name 'pontos.txt' \) | sort)
+fill "$work/corpus/binary" $(find "$root" -type f -name '*.exe' | sort)
+fill "$work/corpus/compressed" "$dir/naruto.webp" \
+  $(find "$root" -type f -name '*.png' | sort)
+head -c "$size" /dev/zero | tr '\000' 'a' > "$work/corpus/same"
+head -c "$size" /dev/urandom > "$work/corpus/random"
+for extra in "$@"; do
+  cp "$extra" "$work/corpus/$(basename "$extra")" || exit 1
+done
+
+report() {
+  if [ "$1" -eq 0 ] && [ -s "$2" ]; then
+    tail -n 1 "$2"
+  else
+    echo null
+  fi
+}
+
+failures=0
+for corpus in "$work"/corpus/*; do
+  name=$(basename "$corpus")
+  for mode in "-c" "-p" "-p --context" "-p --interleave" "-a"; do
+    run=1
+    while [ "$run" -le "$runs" ]; do
+      "$bin" $mode $jobs --json -o "$work/packed" "$corpus" \
+        2> "$work/compress.json"
+      compressed=$?
+      "$bin" -x $jobs --json -o "$work/unpacked" "$work/packed" \
+        2> "$work/extract.json"
+      extracted=$?
+
+      roundtrip=false
+      if [ "$compressed" -eq 0 ] && [ "$extracted" -eq 0 ] &&
+        cmp -s "$corpus" "$work/unpacked"; then
+        roundtrip=true
+      else
+        failures=$((failures + 1))
+        echo "benchmark.sh: round trip failed for $name ($mode)" >&2
+      fi
+
+      printf '{"corpus":"%s","mode":"%s","run":%d,"roundtrip":%s,' \
+        "$name" "$mode" "$run" "$roundtrip"
+      printf '"compress":%s,"extract":%s}\n' \
+        "$(report "$compressed" "$work/compress.json")" \
+        "$(report "$extracted" "$work/extract.json")"
+      run=$((run + 1))
+    done
+  done
+done
+
+[ "$failures" -eq 0 ]
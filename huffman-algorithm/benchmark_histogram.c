@@ -0,0 +1,138 @@
+// Usage: cc -O2 -pthread -o benchmark_histogram benchmark_histogram.c
+//        ./benchmark_histogram [MiB]
+//
+// Times byte counting on generated inputs (default 256 MiB each) and prints
+// GB/s for three kernels, best of RUNS passes:
+//   single     one table, one increment per byte (the original loop)
+//   tables     count_frequencies: four interleaved sub-tables behind an
+//              8-byte run check (what huffman.c uses)
+//   wide       two 64-bit loads per step, bytes split out with shifts into
+//              the four sub-tables, no run check
+// Exits non-zero when a kernel disagrees with the single-table counts.
+
+#define HUFFMAN_NO_MAIN
+#include "huffman.c"
+
+#define RUNS 4
+#define INPUT_KINDS 4
+
+static void count_single(const unsigned char* content, size_t size,
+                         size_t* frequencies) {
+  for (size_t byte = 0; byte < size; byte++) {
+    frequencies[content[byte]]++;
+  }
+}
+
+static void count_word(uint32_t tables[HISTOGRAM_TABLES][ASCII_SIZE],
+                       uint64_t word) {
+  tables[0][(unsigned char)word]++;
+  tables[1][(unsigned char)(word >> 8)]++;
+  tables[2][(unsigned char)(word >> 16)]++;
+  tables[3][(unsigned char)(word >> 24)]++;
+  tables[0][(unsigned char)(word >> 32)]++;
+  tables[1][(unsigned char)(word >> 40)]++;
+  tables[2][(unsigned char)(word >> 48)]++;
+  tables[3][(unsigned char)(word >> 56)]++;
+}
+
+static void count_wide(const unsigned char* content, size_t size,
+                       size_t* frequencies) {
+  uint32_t tables[HISTOGRAM_TABLES][ASCII_SIZE];
+
+  for (size_t offset = 0; offset < size; offset += HISTOGRAM_SEGMENT) {
+    size_t segment = size - offset < HISTOGRAM_SEGMENT ? size - offset
+                                                       : HISTOGRAM_SEGMENT;
+    const unsigned char* bytes = content + offset;
+    memset(tables, 0, sizeof(tables));
+
+    size_t byte = 0;
+    for (; byte + 16 <= segment; byte += 16) {
+      uint64_t first, second;
+      memcpy(&first, bytes + byte, sizeof(uint64_t));
+      memcpy(&second, bytes + byte + 8, sizeof(uint64_t));
+      count_word(tables, first);
+      count_word(tables, second);
+    }
+    for (; byte < segment; byte++) {
+      tables[0][bytes[byte]]++;
+    }
+
+    for (int symbol = 0; symbol < ASCII_SIZE; symbol++) {
+      frequencies[symbol] += (size_t)tables[0][symbol] + tables[1][symbol] +
+                             tables[2][symbol] + tables[3][symbol];
+    }
+  }
+}
+
+static uint64_t next_random(uint64_t* state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+static void fill_input(unsigned char* content, size_t size, int kind) {
+  static const char text[] =
+      "It is a truth universally acknowledged, that a single man in "
+      "possession of a good fortune, must be in want of a wife. ";
+  uint64_t state = 88172645463325252ull;
+  uint64_t value = 0;
+
+  for (size_t byte = 0; byte < size; byte++) {
+    if (kind == 0) {
+      content[byte] = (unsigned char)next_random(&state);
+    } else if (kind == 1) {
+      content[byte] = 'a';
+    } else if (kind == 2) {
+      if (byte % 5 == 0) value = next_random(&state);
+      content[byte] = (unsigned char)value;
+    } else {
+      content[byte] = (unsigned char)text[byte % (sizeof(text) - 1)];
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  static const char* input_names[INPUT_KINDS] = {"random bytes", "one repeated",
+                                                 "short runs", "English text"};
+  static const char* kernel_names[] = {"single", "tables", "wide"};
+  void (*kernels[])(const unsigned char*, size_t, size_t*) = {
+      count_single, count_frequencies, count_wide};
+  int kernel_count = sizeof(kernels) / sizeof(kernels[0]);
+
+  size_t size = (size_t)(argc > 1 ? atoi(argv[1]) : 256) << 20;
+  unsigned char* content = malloc(size);
+  if (size == 0 || !content) {
+    fprintf(stderr, "Could not allocate the input buffer\n");
+    return EXIT_FAILURE;
+  }
+
+  bool matched = true;
+  for (int kind = 0; kind < INPUT_KINDS; kind++) {
+    fill_input(content, size, kind);
+    size_t expected[ASCII_SIZE] = {0};
+    count_single(content, size, expected);
+
+    printf("%-14s", input_names[kind]);
+    for (int kernel = 0; kernel < kernel_count; kernel++) {
+      double best = 0;
+      for (int run = 0; run < RUNS; run++) {
+        size_t frequencies[ASCII_SIZE] = {0};
+        double start = get_time();
+        kernels[kernel](content, size, frequencies);
+        double seconds = get_time() - start;
+        if (run == 0 || seconds < best) best = seconds;
+        if (memcmp(frequencies, expected, sizeof(expected)) != 0) {
+          fprintf(stderr, "%s miscounted %s\n", kernel_names[kernel],
+                  input_names[kind]);
+          matched = false;
+        }
+      }
+      printf("  %s %5.2f GB/s", kernel_names[kernel], size / best / 1e9);
+    }
+    printf("\n");
+  }
+
+  free(content);
+  return matched ? EXIT_SUCCESS : EXIT_FAILURE;
+}
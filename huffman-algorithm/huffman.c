@@ -1,23 +1,359 @@
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <pthread.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "huffman.h"
+
+#if defined(HUFFMAN_NO_MAIN) && defined(__GNUC__)
+#pragma GCC diagnostic ignored "-Wunused-function"
+#endif
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <nmmintrin.h>
+#define HAVE_CRC32C_HARDWARE 1
+#endif
+
+#if defined(__GNUC__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define HAVE_BYTE_SWAP 1
+#endif
 
 #define FILE_NAME_SIZE 200
 #define ASCII_SIZE 256
+#define IO_BUFFER_SIZE (1 << 20)
+#define DECODE_TABLE_BITS 11
+#define DECODE_TABLE_SIZE (1 << DECODE_TABLE_BITS)
+#define DECODE_MAX_SYMBOLS 3
+#define MAX_CODE_LENGTH 64
+#define MIN_CODE_LENGTH_LIMIT 8
+#define DEFAULT_MAX_CODE_LENGTH 15
+#define FORMAT_TREE 0
+#define FORMAT_CANONICAL 1
+#define FORMAT_STREAM 2
+#define CANONICAL_HEADER_SIZE (4 + ASCII_SIZE)
+#define STREAM_TRAILER_SIZE 9
+#define FORMAT_BLOCKS 3
+#define FORMAT_ADAPTIVE 4
+#define FORMAT_DICTIONARY 5
+#define DICTIONARY_HEADER_SIZE 8
+#define DICTIONARY_FILE_SIZE (8 + ASCII_SIZE)
+#define BLOCK_SIZE (1 << 20)
+#define MAX_BLOCK_SIZE (1 << 30)
+#define BLOCK_HEADER_SIZE (9 + ASCII_SIZE)
+#define BLOCK_CHECKSUM_SIZE 4
+#define STORED_HEADER_SIZE 5
+#define BLOCK_FLAG_CHECKSUM 0x01
+#define BLOCK_FLAG_COMPACT_STORED 0x02
+#define BLOCK_FLAGS (BLOCK_FLAG_CHECKSUM | BLOCK_FLAG_COMPACT_STORED)
+#define BLOCK_TYPE_SHIFT 4
+#define BLOCK_TYPE_HUFFMAN 0
+#define BLOCK_TYPE_CONTEXT 1
+#define BLOCK_TYPE_STORED 2
+#define BLOCK_TYPE_INTERLEAVED 3
+#define INTERLEAVED_STREAMS 4
+#define INTERLEAVED_JUMP_SIZE (4 * (INTERLEAVED_STREAMS - 1))
+#define LOOKUP_TABLE_BITS 11
+#define LOOKUP_TABLE_SIZE (1 << LOOKUP_TABLE_BITS)
+#define LOOKUP_RELOAD_SYMBOLS (56 / LOOKUP_TABLE_BITS)
+#define CONTEXT_BITMAP_SIZE (ASCII_SIZE / 8)
+#define CONTEXT_MIN_COUNT (LOOKUP_TABLE_SIZE / 8)
+#define MIN_BLOCK_SIZE (1 << 12)
+#define CRC32C_POLYNOMIAL 0x82F63B78u
+#define BLOCK_BATCH_FACTOR 4
+#define HISTOGRAM_TABLES 4
+#define HISTOGRAM_SEGMENT (1u << 30)
+#define NO_CHILD 0xFFFF
+#define MAX_TREE_NODES 0xFFFF
+#define ADAPTIVE_NODES (2 * ASCII_SIZE + 1)
+#define ADAPTIVE_ROOT (ADAPTIVE_NODES - 1)
 
-typedef struct node {
-  void* element;
-  size_t frequency;
-  struct node* next;
-  struct node* left;
-  struct node* right;
+typedef struct {
+  uint16_t left;
+  uint16_t right;
+  unsigned char symbol;
 } node_t;
 
-void log_info(const char* message) { printf("%s\n", message); }
-void log_error(const char* message) { fprintf(stderr, "Error: %s\n", message); }
+typedef enum {
+  PHASE_OTHER,
+  PHASE_READ,
+  PHASE_HISTOGRAM,
+  PHASE_TREE,
+  PHASE_ENCODE,
+  PHASE_DECODE,
+  PHASE_CHECKSUM,
+  PHASE_WRITE,
+  PHASE_COUNT
+} phase_t;
+
+typedef struct {
+  double seconds[PHASE_COUNT];
+  phase_t phase;
+  double phase_start;
+  double start_time;
+  uint64_t raw_bytes;
+  uint64_t packed_bytes;
+} stats_t;
+
+typedef struct {
+  node_t* nodes;
+  size_t count;
+  size_t capacity;
+  uint16_t root;
+} tree_t;
+
+typedef struct {
+  size_t frequency;
+  unsigned char symbol;
+} leaf_t;
+
+typedef struct {
+  size_t weights[MAX_CODE_LENGTH * 2 * ASCII_SIZE];
+  int16_t symbols[MAX_CODE_LENGTH * 2 * ASCII_SIZE];
+  size_t level_sizes[MAX_CODE_LENGTH];
+} package_merge_t;
+
+typedef struct {
+  node_t nodes[ADAPTIVE_NODES];
+  uint16_t parents[ADAPTIVE_NODES];
+  uint64_t weights[ADAPTIVE_NODES];
+  uint16_t leaves[ASCII_SIZE];
+  uint16_t nyt;
+} adaptive_tree_t;
+
+typedef struct {
+  uint64_t bits;
+  unsigned char length;
+} code_t;
+
+typedef struct {
+  FILE* file;
+  unsigned char* buffer;
+  size_t size;
+  size_t capacity;
+  uint64_t bits;
+  int count;
+  uint64_t total_bits;
+  bool failed;
+  stats_t* stats;
+} bit_writer_t;
+
+typedef struct {
+  unsigned char symbols[DECODE_MAX_SYMBOLS];
+  unsigned char count;
+  unsigned char bits;
+  uint16_t node;
+} decode_entry_t;
+
+typedef struct {
+  FILE* file;
+  unsigned char* buffer;
+  size_t size;
+  size_t position;
+  size_t held;
+  uint64_t bits;
+  int count;
+  unsigned int trash_size;
+  size_t trailer_size;
+  unsigned char trailer[STREAM_TRAILER_SIZE];
+  bool end_of_file;
+  bool truncated;
+  stats_t* stats;
+} bit_reader_t;
+
+typedef struct {
+  const unsigned char* next;
+  const unsigned char* end;
+  uint64_t bits;
+  int count;
+} lookup_stream_t;
+
+typedef struct {
+  FILE* file;
+  unsigned char* buffer;
+  size_t size;
+  size_t capacity;
+  uint64_t total;
+  stats_t* stats;
+} output_buffer_t;
+
+typedef struct {
+  FILE* file;
+  unsigned char* data;
+  size_t size;
+  size_t position;
+  bool mapped;
+  stats_t* stats;
+} input_t;
+
+typedef struct thread_pool {
+  pthread_t* threads;
+  int thread_count;
+  pthread_mutex_t mutex;
+  pthread_cond_t work_ready;
+  pthread_cond_t work_done;
+  void (*job)(void* context, size_t index);
+  void* context;
+  size_t job_count;
+  size_t next_job;
+  size_t finished_jobs;
+  unsigned long generation;
+  bool stopping;
+} thread_pool_t;
+
+typedef struct {
+  const unsigned char* source;
+  size_t source_size;
+  unsigned char* target;
+  size_t target_size;
+  unsigned char* input;
+  size_t input_capacity;
+  unsigned char* output;
+  size_t output_capacity;
+  unsigned char lengths[ASCII_SIZE];
+  unsigned int trash_size;
+  unsigned int block_type;
+  uint32_t checksum;
+  bool checksummed;
+  int max_code_length;
+  bool context_model;
+  bool interleaved;
+  tree_t tree;
+  package_merge_t* package_merge;
+  decode_entry_t* table;
+  uint16_t* lookup_table;
+  uint32_t* context_counts;
+  unsigned char* context_lengths;
+  uint16_t* context_codes;
+  uint16_t* context_tables;
+  stats_t stats;
+  huffman_status_t status;
+} block_job_t;
+
+typedef struct {
+  uint32_t id;
+  code_t codes[ASCII_SIZE];
+  tree_t tree;
+  decode_entry_t* table;
+} dictionary_t;
+
+typedef struct {
+  uint64_t offset;
+  uint64_t length;
+} byte_range_t;
+
+typedef enum { STREAM_IDLE, STREAM_COMPRESSING, STREAM_EXTRACTING } stream_t;
+
+struct huffman_context {
+  block_job_t job;
+  size_t block_size;
+  huffman_write_t write;
+  void* opaque;
+  stream_t stream;
+  unsigned char* pending;
+  size_t pending_size;
+  size_t pending_capacity;
+  uint64_t* offsets;
+  size_t block_count;
+  size_t offsets_capacity;
+  uint64_t offset;
+  size_t archive_block_size;
+  unsigned int flags;
+  bool header_read;
+  bool end_of_blocks;
+};
+
+typedef struct {
+  unsigned char* data;
+  size_t size;
+  size_t capacity;
+  bool overflow;
+} memory_sink_t;
+
+typedef struct {
+  const char* input_name;
+  char* output_name;
+  char action;
+  int worker_count;
+  int max_code_length;
+  size_t block_size;
+  bool context_model;
+  bool interleaved;
+  const dictionary_t* dictionary;
+  const byte_range_t* range;
+  stats_t stats;
+  bool valid;
+} file_job_t;
+
+#ifndef HUFFMAN_NO_MAIN
+static void log_info(const char* message) { printf("%s\n", message); }
+static void log_error(const char* message) {
+  fprintf(stderr, "Error: %s\n", message);
+}
+static void log_file_error(const char* message, const char* file_name) {
+  fprintf(stderr, "Error: %s: %s\n", message, file_name ? file_name : "-");
+}
+#else
+static void log_info(const char* message) { (void)message; }
+static void log_error(const char* message) { (void)message; }
+static void log_file_error(const char* message, const char* file_name) {
+  (void)message;
+  (void)file_name;
+}
+#endif
+
+static double get_time() {
+  struct timespec now;
+#ifdef _WIN32
+  timespec_get(&now, TIME_UTC);
+#else
+  clock_gettime(CLOCK_MONOTONIC, &now);
+#endif
+  return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+static void start_stats(stats_t* stats) {
+  memset(stats, 0, sizeof(stats_t));
+  stats->phase = PHASE_OTHER;
+  stats->phase_start = get_time();
+  stats->start_time = stats->phase_start;
+}
+
+static phase_t enter_phase(stats_t* stats, phase_t phase) {
+  if (stats == NULL) return phase;
+
+  double now = get_time();
+  phase_t previous = stats->phase;
+  stats->seconds[previous] += now - stats->phase_start;
+  stats->phase = phase;
+  stats->phase_start = now;
+  return previous;
+}
+
+static void merge_stats(stats_t* stats, const stats_t* part) {
+  if (stats == NULL) return;
 
-char* get_file_name() {
+  for (int phase = PHASE_READ; phase < PHASE_COUNT; phase++) {
+    stats->seconds[phase] += part->seconds[phase];
+  }
+}
+
+static char* get_file_name() {
   char* file_name = malloc(FILE_NAME_SIZE * sizeof(char));
   if (file_name == NULL) {
     log_error("Could not allocate memory for file name");
@@ -30,7 +366,8 @@ char* get_file_name() {
   return file_name;
 }
 
-unsigned char* get_file_content(const char* file_name, size_t* file_size) {
+static unsigned char* get_file_content(const char* file_name,
+                                       size_t* file_size) {
   FILE* file = fopen(file_name, "rb");
   if (file == NULL) {
     log_error("Could not open file");
@@ -62,156 +399,477 @@ unsigned char* get_file_content(const char* file_name, size_t* file_size) {
   return content;
 }
 
-size_t* get_frequencies(const unsigned char* content, const size_t file_size) {
-  size_t* frequencies = calloc(ASCII_SIZE, sizeof(size_t));
-  if (frequencies == NULL) {
-    log_error("Could not allocate memory for frequencies table");
-    exit(EXIT_FAILURE);
+static void open_input(input_t* input, FILE* file) {
+  input->file = file;
+  input->data = NULL;
+  input->size = 0;
+  input->position = 0;
+  input->mapped = false;
+  input->stats = NULL;
+
+#ifndef _WIN32
+  struct stat info;
+  long position = ftell(file);
+  if (position < 0 || fstat(fileno(file), &info) != 0 ||
+      !S_ISREG(info.st_mode) || info.st_size <= position) {
+    return;
   }
 
-  for (size_t byte = 0; byte < file_size; byte++) {
-    frequencies[content[byte]]++;
+  void* data =
+      mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+  if (data == MAP_FAILED) return;
+
+  madvise(data, (size_t)info.st_size, MADV_SEQUENTIAL);
+  input->data = data;
+  input->size = (size_t)info.st_size;
+  input->position = (size_t)position;
+  input->mapped = true;
+#endif
+}
+
+static void close_input(input_t* input) {
+#ifndef _WIN32
+  if (input->mapped) munmap(input->data, input->size);
+#endif
+  input->mapped = false;
+}
+
+static size_t read_input(input_t* input, void* buffer, size_t size) {
+  if (!input->mapped) {
+    phase_t previous = enter_phase(input->stats, PHASE_READ);
+    size = fread(buffer, sizeof(unsigned char), size, input->file);
+    enter_phase(input->stats, previous);
+    return size;
   }
 
-  return frequencies;
+  size_t available = input->size - input->position;
+  if (size > available) size = available;
+  memcpy(buffer, input->data + input->position, size);
+  input->position += size;
+  return size;
 }
 
-node_t* add_to_list_ordered(node_t* head, node_t* new_node) {
-  if (head == NULL) {
-    head = new_node;
-  } else if (head->frequency > new_node->frequency) {
-    new_node->next = head;
-    head = new_node;
-  } else {
-    node_t* aux = head;
-    while (aux->next && aux->next->frequency < new_node->frequency) {
-      aux = aux->next;
-    }
-    new_node->next = aux->next;
-    aux->next = new_node;
+static const unsigned char* read_chunk(input_t* input, unsigned char* buffer,
+                                       size_t max_size, size_t* size) {
+  if (!input->mapped) {
+    phase_t previous = enter_phase(input->stats, PHASE_READ);
+    *size = fread(buffer, sizeof(unsigned char), max_size, input->file);
+    enter_phase(input->stats, previous);
+    return buffer;
   }
 
-  return head;
+  size_t available = input->size - input->position;
+  *size = available < max_size ? available : max_size;
+  const unsigned char* chunk = input->data + input->position;
+  input->position += *size;
+  return chunk;
 }
 
-node_t* create_list(const size_t* frequencies) {
-  node_t* head = NULL;
+static unsigned char* map_file_content(const char* file_name, size_t* file_size,
+                                       bool* mapped) {
+  FILE* file = fopen(file_name, "rb");
+  if (file == NULL) {
+    log_error("Could not open file");
+    exit(EXIT_FAILURE);
+  }
 
-  for (unsigned int index = 0; index < ASCII_SIZE; index++) {
-    if (frequencies[index] > 0) {
-      node_t* new_node = malloc(sizeof(node_t));
-      if (!new_node) {
-        log_error("Could not allocate memory for node");
-        exit(EXIT_FAILURE);
-      }
+  input_t input;
+  open_input(&input, file);
+  fclose(file);
 
-      new_node->element = malloc(sizeof(unsigned char));
-      if (!new_node->element) {
-        log_error("Could not allocate memory for element");
-        free(new_node);
-        exit(EXIT_FAILURE);
-      }
+  *mapped = input.mapped;
+  if (input.mapped) {
+    *file_size = input.size;
+    return input.data;
+  }
+  return get_file_content(file_name, file_size);
+}
+
+static void release_file_content(unsigned char* content, size_t file_size,
+                                 bool mapped) {
+#ifndef _WIN32
+  if (mapped) {
+    munmap(content, file_size);
+    return;
+  }
+#endif
+  free(content);
+}
+
+static void count_bytes(uint32_t tables[HISTOGRAM_TABLES][ASCII_SIZE],
+                        const unsigned char* bytes) {
+  tables[0][bytes[0]]++;
+  tables[1][bytes[1]]++;
+  tables[2][bytes[2]]++;
+  tables[3][bytes[3]]++;
+  tables[0][bytes[4]]++;
+  tables[1][bytes[5]]++;
+  tables[2][bytes[6]]++;
+  tables[3][bytes[7]]++;
+}
 
-      *(unsigned char*)new_node->element = (unsigned char)index;
-      new_node->frequency = frequencies[index];
-      new_node->next = NULL;
-      new_node->left = NULL;
-      new_node->right = NULL;
+static void count_segment(const unsigned char* content, size_t size,
+                          uint32_t tables[HISTOGRAM_TABLES][ASCII_SIZE]) {
+  size_t byte = 0;
 
-      head = add_to_list_ordered(head, new_node);
+  for (; byte + 8 <= size; byte += 8) {
+    uint64_t word;
+    memcpy(&word, content + byte, sizeof(uint64_t));
+    if (word == content[byte] * UINT64_C(0x0101010101010101)) {
+      tables[0][content[byte]] += 8;
+    } else {
+      count_bytes(tables, content + byte);
     }
   }
 
-  return head;
+  for (; byte < size; byte++) {
+    tables[0][content[byte]]++;
+  }
 }
 
-node_t* fuse_nodes(node_t* head) {
-  if (!head || !head->next) {
-    log_error("List too short to fuse nodes");
-    return head;
-  }
+static void count_frequencies(const unsigned char* content, size_t size,
+                              size_t* frequencies) {
+  uint32_t tables[HISTOGRAM_TABLES][ASCII_SIZE];
 
-  node_t* first = head;
-  node_t* second = head->next;
-  node_t* rest = second->next;
+  for (size_t offset = 0; offset < size; offset += HISTOGRAM_SEGMENT) {
+    size_t segment = size - offset < HISTOGRAM_SEGMENT ? size - offset
+                                                       : HISTOGRAM_SEGMENT;
+    memset(tables, 0, sizeof(tables));
+    count_segment(content + offset, segment, tables);
 
-  node_t* new_node = malloc(sizeof(node_t));
-  if (new_node == NULL) {
-    log_error("Could not allocate memory for node fusion");
-    exit(EXIT_FAILURE);
+    for (int symbol = 0; symbol < ASCII_SIZE; symbol++) {
+      frequencies[symbol] += (size_t)tables[0][symbol] + tables[1][symbol] +
+                             tables[2][symbol] + tables[3][symbol];
+    }
   }
-  new_node->element = malloc(sizeof(unsigned char));
-  if (new_node->element == NULL) {
-    log_error("Could not allocate memory for element in node fusion");
-    free(new_node);
+}
+
+static size_t* get_frequencies(const unsigned char* content,
+                               const size_t file_size) {
+  size_t* frequencies = calloc(ASCII_SIZE, sizeof(size_t));
+  if (frequencies == NULL) {
+    log_error("Could not allocate memory for frequencies table");
     exit(EXIT_FAILURE);
   }
-  *(unsigned char*)new_node->element = '*';
-  new_node->frequency = first->frequency + second->frequency;
-  new_node->left = first;
-  new_node->right = second;
-  new_node->next = NULL;
 
-  first->next = NULL;
-  second->next = NULL;
+  count_frequencies(content, file_size, frequencies);
 
-  head = add_to_list_ordered(rest, new_node);
-  return head;
+  return frequencies;
 }
 
-node_t* create_tree(node_t* head) {
-  if (head == NULL) {
-    log_error("Empty list - cannot create tree");
-    exit(EXIT_FAILURE);
+static int compare_leaves(const void* first, const void* second) {
+  const leaf_t* left = first;
+  const leaf_t* right = second;
+
+  if (left->frequency != right->frequency) {
+    return left->frequency < right->frequency ? -1 : 1;
   }
+  return (int)left->symbol - (int)right->symbol;
+}
+
+static void init_tree(tree_t* tree) {
+  tree->nodes = NULL;
+  tree->count = 0;
+  tree->capacity = 0;
+  tree->root = NO_CHILD;
+}
+
+static void destroy_tree(tree_t* tree) {
+  free(tree->nodes);
+  init_tree(tree);
+}
+
+static bool grow_tree(tree_t* tree, size_t capacity) {
+  if (capacity <= tree->capacity) return true;
+
+  node_t* nodes = realloc(tree->nodes, capacity * sizeof(node_t));
+  if (!nodes) return false;
+  tree->nodes = nodes;
+  tree->capacity = capacity;
+  return true;
+}
+
+static bool reserve_tree(tree_t* tree, size_t capacity) {
+  tree->count = 0;
+  tree->root = NO_CHILD;
+  return grow_tree(tree, capacity);
+}
 
-  while (head->next != NULL) {
-    head = fuse_nodes(head);
+static uint16_t add_node(tree_t* tree, uint16_t left, uint16_t right,
+                         unsigned char symbol) {
+  if (tree->count >= MAX_TREE_NODES) return NO_CHILD;
+
+  if (tree->count == tree->capacity &&
+      !grow_tree(tree, tree->capacity < ASCII_SIZE ? 2 * ASCII_SIZE
+                                                   : tree->capacity * 2)) {
+    return NO_CHILD;
   }
 
-  return head;
+  node_t* node = &tree->nodes[tree->count];
+  node->left = left;
+  node->right = right;
+  node->symbol = symbol;
+  return (uint16_t)tree->count++;
+}
+
+static bool is_leaf(const tree_t* tree, uint16_t index) {
+  return tree->nodes[index].left == NO_CHILD &&
+         tree->nodes[index].right == NO_CHILD;
+}
+
+static uint16_t take_smallest(const size_t* weights, size_t leaf_count,
+                              size_t* leaves_taken, size_t* internal_taken,
+                              size_t internal_created) {
+  size_t leaf = *leaves_taken;
+  size_t internal = leaf_count + *internal_taken;
+
+  if (*internal_taken == internal_created ||
+      (leaf < leaf_count && weights[leaf] <= weights[internal])) {
+    (*leaves_taken)++;
+    return (uint16_t)leaf;
+  }
+  (*internal_taken)++;
+  return (uint16_t)internal;
 }
 
-void destroy_tree(node_t* root) {
-  if (root == NULL) return;
-  destroy_tree(root->left);
-  destroy_tree(root->right);
-  if (root->element) free(root->element);
-  free(root);
+static bool create_tree(tree_t* tree, const size_t* frequencies,
+                        size_t symbol_count) {
+  leaf_t leaves[ASCII_SIZE];
+  size_t leaf_count = 0;
+  for (size_t symbol = 0; symbol < symbol_count; symbol++) {
+    if (frequencies[symbol] == 0) continue;
+
+    leaves[leaf_count].frequency = frequencies[symbol];
+    leaves[leaf_count].symbol = (unsigned char)symbol;
+    leaf_count++;
+  }
+
+  if (leaf_count == 0) {
+    log_error("Empty list - cannot create tree");
+    return false;
+  }
+
+  qsort(leaves, leaf_count, sizeof(leaf_t), compare_leaves);
+  if (!reserve_tree(tree, 2 * leaf_count - 1)) return false;
+
+  size_t weights[2 * ASCII_SIZE - 1];
+  for (size_t leaf = 0; leaf < leaf_count; leaf++) {
+    weights[leaf] = leaves[leaf].frequency;
+    add_node(tree, NO_CHILD, NO_CHILD, leaves[leaf].symbol);
+  }
+
+  size_t leaves_taken = 0;
+  size_t internal_taken = 0;
+  for (size_t created = 0; created < leaf_count - 1; created++) {
+    uint16_t first = take_smallest(weights, leaf_count, &leaves_taken,
+                                   &internal_taken, created);
+    uint16_t second = take_smallest(weights, leaf_count, &leaves_taken,
+                                    &internal_taken, created);
+
+    weights[leaf_count + created] = weights[first] + weights[second];
+    add_node(tree, first, second, '*');
+  }
+
+  tree->root = (uint16_t)(tree->count - 1);
+  return true;
 }
 
-int get_tree_height(node_t* root) {
-  if (root == NULL) return -1;
-  if (root->left == NULL && root->right == NULL) return 0;
+static int get_tree_height(const tree_t* tree, uint16_t index) {
+  if (index == NO_CHILD) return -1;
+  if (is_leaf(tree, index)) return 0;
 
-  int left_height = get_tree_height(root->left);
-  int right_height = get_tree_height(root->right);
+  int left_height = get_tree_height(tree, tree->nodes[index].left);
+  int right_height = get_tree_height(tree, tree->nodes[index].right);
 
   return (left_height > right_height ? left_height : right_height) + 1;
 }
 
-void generate_codes(node_t* root, char** codes, char* current_code, int depth) {
-  if (root == NULL) return;
+static void generate_codes(const tree_t* tree, uint16_t index, code_t* codes,
+                           uint64_t code, int depth) {
+  if (index == NO_CHILD) return;
 
-  if (root->left == NULL && root->right == NULL) {
-    current_code[depth] = '\0';
-    unsigned char element = *(unsigned char*)root->element;
-    strcpy(codes[element], current_code);
+  const node_t* node = &tree->nodes[index];
+  if (is_leaf(tree, index)) {
+    codes[node->symbol].bits = code;
+    codes[node->symbol].length = (unsigned char)depth;
     return;
   }
 
-  if (root->left != NULL) {
-    current_code[depth] = '0';
-    generate_codes(root->left, codes, current_code, depth + 1);
+  generate_codes(tree, node->left, codes, code << 1, depth + 1);
+  generate_codes(tree, node->right, codes, (code << 1) | 1, depth + 1);
+}
+
+static void get_code_lengths(const code_t* codes, unsigned char* lengths) {
+  for (int i = 0; i < ASCII_SIZE; i++) {
+    lengths[i] = codes[i].length;
+  }
+}
+
+static bool generate_canonical_codes(const unsigned char* lengths,
+                                     code_t* codes) {
+  uint64_t code = 0;
+  int code_length = 0;
+  bool assigned = false;
+
+  for (int i = 0; i < ASCII_SIZE; i++) {
+    if (lengths[i] > MAX_CODE_LENGTH) return false;
+    codes[i].bits = 0;
+    codes[i].length = 0;
+  }
+
+  for (int length = 1; length <= MAX_CODE_LENGTH; length++) {
+    for (int symbol = 0; symbol < ASCII_SIZE; symbol++) {
+      if (lengths[symbol] != length) continue;
+
+      if (assigned) {
+        code++;
+        if (code_length < 64 ? (code >> code_length) != 0 : code == 0) {
+          return false;
+        }
+      }
+
+      code = length - code_length < 64 ? code << (length - code_length) : 0;
+      code_length = length;
+      assigned = true;
+
+      codes[symbol].bits = code;
+      codes[symbol].length = (unsigned char)length;
+    }
+  }
+
+  return true;
+}
+
+static bool build_tree_from_codes(const code_t* codes, tree_t* tree) {
+  if (!reserve_tree(tree, 2 * ASCII_SIZE - 1)) return false;
+  tree->root = add_node(tree, NO_CHILD, NO_CHILD, '*');
+
+  for (int symbol = 0; symbol < ASCII_SIZE; symbol++) {
+    const code_t* code = &codes[symbol];
+    if (code->length == 0) continue;
+
+    uint16_t current = tree->root;
+    for (int bit = code->length - 1; bit >= 0; bit--) {
+      bool right = (code->bits >> bit) & 1;
+      uint16_t child =
+          right ? tree->nodes[current].right : tree->nodes[current].left;
+      if (child == NO_CHILD) {
+        child = add_node(tree, NO_CHILD, NO_CHILD, '*');
+        if (child == NO_CHILD) return false;
+        if (right) {
+          tree->nodes[current].right = child;
+        } else {
+          tree->nodes[current].left = child;
+        }
+      }
+      current = child;
+    }
+    tree->nodes[current].symbol = (unsigned char)symbol;
+  }
+
+  return true;
+}
+
+static bool limit_code_lengths(const size_t* frequencies, int max_length,
+                               unsigned char* lengths,
+                               package_merge_t** scratch) {
+  if (!*scratch) *scratch = malloc(sizeof(package_merge_t));
+  if (!*scratch) return false;
+
+  leaf_t leaves[ASCII_SIZE];
+  size_t leaf_count = 0;
+  for (int symbol = 0; symbol < ASCII_SIZE; symbol++) {
+    if (frequencies[symbol] == 0) continue;
+
+    leaves[leaf_count].frequency = frequencies[symbol];
+    leaves[leaf_count].symbol = (unsigned char)symbol;
+    leaf_count++;
+  }
+  memset(lengths, 0, ASCII_SIZE);
+  if (leaf_count == 0) return true;
+  qsort(leaves, leaf_count, sizeof(leaf_t), compare_leaves);
+
+  size_t level_capacity = 2 * leaf_count;
+  size_t* weights = (*scratch)->weights;
+  int16_t* symbols = (*scratch)->symbols;
+  size_t* level_sizes = (*scratch)->level_sizes;
+
+  for (int level = max_length - 1; level >= 0; level--) {
+    size_t* level_weights = &weights[level * level_capacity];
+    int16_t* level_symbols = &symbols[level * level_capacity];
+    size_t packages = 0;
+    if (level < max_length - 1) packages = level_sizes[level + 1] / 2;
+
+    size_t leaf = 0;
+    size_t package = 0;
+    size_t size = 0;
+    while (leaf < leaf_count || package < packages) {
+      size_t package_weight = 0;
+      if (package < packages) {
+        const size_t* previous = &weights[(level + 1) * level_capacity];
+        package_weight = previous[2 * package] + previous[2 * package + 1];
+      }
+
+      if (package == packages ||
+          (leaf < leaf_count && leaves[leaf].frequency <= package_weight)) {
+        level_weights[size] = leaves[leaf].frequency;
+        level_symbols[size] = leaves[leaf].symbol;
+        leaf++;
+      } else {
+        level_weights[size] = package_weight;
+        level_symbols[size] = -1;
+        package++;
+      }
+      size++;
+    }
+    level_sizes[level] = size;
+  }
+
+  size_t selected = 2 * leaf_count - 2;
+  for (int level = 0; level < max_length && selected > 0; level++) {
+    const int16_t* level_symbols = &symbols[level * level_capacity];
+    size_t packages = 0;
+    for (size_t item = 0; item < selected; item++) {
+      if (level_symbols[item] < 0) {
+        packages++;
+      } else {
+        lengths[level_symbols[item]]++;
+      }
+    }
+    selected = 2 * packages;
+  }
+  return true;
+}
+
+static bool build_codes(tree_t* tree, const size_t* frequencies, code_t* codes,
+                        bool canonical, int max_length,
+                        package_merge_t** scratch) {
+  if (!create_tree(tree, frequencies, ASCII_SIZE)) return false;
+
+  if (get_tree_height(tree, tree->root) > max_length) {
+    unsigned char lengths[ASCII_SIZE];
+    if (!limit_code_lengths(frequencies, max_length, lengths, scratch)) {
+      return false;
+    }
+    generate_canonical_codes(lengths, codes);
+    return build_tree_from_codes(codes, tree);
   }
 
-  if (root->right != NULL) {
-    current_code[depth] = '1';
-    generate_codes(root->right, codes, current_code, depth + 1);
+  memset(codes, 0, ASCII_SIZE * sizeof(code_t));
+  generate_codes(tree, tree->root, codes, 0, 0);
+
+  if (canonical) {
+    unsigned char lengths[ASCII_SIZE];
+    get_code_lengths(codes, lengths);
+    if (is_leaf(tree, tree->root)) {
+      lengths[tree->nodes[tree->root].symbol] = 1;
+    }
+    generate_canonical_codes(lengths, codes);
   }
+  return true;
 }
 
-void change_file_extension(char* file_name, const char* new_extension) {
+static void change_file_extension(char* file_name, const char* new_extension) {
   char* dot_position = strrchr(file_name, '.');
   if (dot_position != NULL) {
     *dot_position = '\0';
@@ -219,16 +877,27 @@ void change_file_extension(char* file_name, const char* new_extension) {
   strcat(file_name, new_extension);
 }
 
-void write_trash_and_size(FILE* file, unsigned int trash, unsigned int size) {
+static void write_trash_and_size(FILE* file, unsigned int trash,
+                                 unsigned int size) {
   unsigned short header = (trash << 13) | (size & 0x1FFF);
   fwrite(&header, sizeof(unsigned short), 1, file);
 }
 
-void write_tree(FILE* file, node_t* root) {
-  if (root == NULL) return;
+static void write_canonical_header(FILE* file, unsigned int format,
+                                   unsigned int trash,
+                                   const unsigned char* lengths) {
+  unsigned char header[4] = {'H', 'F', (unsigned char)format,
+                             (unsigned char)trash};
+  fwrite(header, sizeof(unsigned char), sizeof(header), file);
+  fwrite(lengths, sizeof(unsigned char), ASCII_SIZE, file);
+}
+
+static void write_tree(FILE* file, const tree_t* tree, uint16_t index) {
+  if (index == NO_CHILD) return;
 
-  if (root->left == NULL && root->right == NULL) {
-    unsigned char element = *(unsigned char*)root->element;
+  const node_t* node = &tree->nodes[index];
+  if (is_leaf(tree, index)) {
+    unsigned char element = node->symbol;
     if (element == '*' || element == '\\') {
       unsigned char escape = '\\';
       fwrite(&escape, sizeof(unsigned char), 1, file);
@@ -237,225 +906,2533 @@ void write_tree(FILE* file, node_t* root) {
   } else {
     unsigned char marker = '*';
     fwrite(&marker, sizeof(unsigned char), 1, file);
-    write_tree(file, root->left);
-    write_tree(file, root->right);
+    write_tree(file, tree, node->left);
+    write_tree(file, tree, node->right);
   }
 }
 
-unsigned int calculate_trash_size(const unsigned char* content,
-                                  size_t file_size, char** codes) {
-  size_t total_bits = 0;
+static unsigned int calculate_tree_size(const tree_t* tree, uint16_t index) {
+  if (index == NO_CHILD) return 0;
 
-  for (size_t i = 0; i < file_size; i++) {
-    unsigned char byte = content[i];
-    total_bits += strlen(codes[byte]);
+  const node_t* node = &tree->nodes[index];
+  if (is_leaf(tree, index)) {
+    if (node->symbol == '*' || node->symbol == '\\') {
+      return 2;
+    }
+    return 1;
   }
 
-  unsigned int trash_size = (8 - (total_bits % 8)) % 8;
-  return trash_size;
+  return 1 + calculate_tree_size(tree, node->left) +
+         calculate_tree_size(tree, node->right);
 }
 
-unsigned int calculate_tree_size(node_t* root) {
-  if (root == NULL) return 0;
+static bool write_bytes(FILE* file, const void* bytes, size_t size) {
+  return size == 0 || fwrite(bytes, sizeof(unsigned char), size, file) == size;
+}
 
-  if (root->left == NULL && root->right == NULL) {
-    unsigned char element = *(unsigned char*)root->element;
-    if (element == '*' || element == '\\') {
-      return 2;
-    }
-    return 1;
+static void init_bit_writer(bit_writer_t* writer, FILE* file,
+                            unsigned char* buffer, size_t capacity) {
+  writer->file = file;
+  writer->buffer = buffer;
+  writer->size = 0;
+  writer->capacity = capacity;
+  writer->bits = 0;
+  writer->count = 0;
+  writer->total_bits = 0;
+  writer->failed = false;
+  writer->stats = NULL;
+}
+
+static void flush_bit_writer_buffer(bit_writer_t* writer) {
+  if (writer->file == NULL) return;
+
+  phase_t previous = enter_phase(writer->stats, PHASE_WRITE);
+  if (!write_bytes(writer->file, writer->buffer, writer->size)) {
+    writer->failed = true;
+  }
+  enter_phase(writer->stats, previous);
+  writer->size = 0;
+}
+
+static void put_bits(bit_writer_t* writer, uint64_t bits, int length) {
+  writer->bits = (writer->bits << length) | bits;
+  writer->count += length;
+  writer->total_bits += length;
+
+  if (writer->count >= 32) {
+    uint32_t word = (uint32_t)(writer->bits >> (writer->count - 32));
+    unsigned char* output = writer->buffer + writer->size;
+    output[0] = (unsigned char)(word >> 24);
+    output[1] = (unsigned char)(word >> 16);
+    output[2] = (unsigned char)(word >> 8);
+    output[3] = (unsigned char)word;
+    writer->size += 4;
+    writer->count -= 32;
+
+    if (writer->size == writer->capacity) flush_bit_writer_buffer(writer);
+  }
+}
+
+static void put_code(bit_writer_t* writer, const code_t* code) {
+  if (code->length > 32) {
+    put_bits(writer, code->bits >> 32, code->length - 32);
+    put_bits(writer, code->bits & 0xFFFFFFFF, 32);
+  } else {
+    put_bits(writer, code->bits, code->length);
+  }
+}
+
+static unsigned int finish_bit_writer(bit_writer_t* writer) {
+  unsigned int trash_size = (8 - (writer->total_bits % 8)) % 8;
+
+  while (writer->count >= 8) {
+    writer->buffer[writer->size++] =
+        (unsigned char)(writer->bits >> (writer->count - 8));
+    writer->count -= 8;
+  }
+  if (writer->count > 0) {
+    writer->buffer[writer->size++] =
+        (unsigned char)(writer->bits << (8 - writer->count));
+    writer->count = 0;
   }
 
-  return 1 + calculate_tree_size(root->left) + calculate_tree_size(root->right);
+  flush_bit_writer_buffer(writer);
+  return trash_size;
 }
 
-void write_compressed_file(const char* file_name, const unsigned char* content,
-                           size_t file_size, char** codes, node_t* root) {
+static void write_compressed_file(const char* file_name,
+                                  const unsigned char* content,
+                                  size_t file_size, const code_t* codes,
+                                  const tree_t* tree, int format) {
   FILE* file = fopen(file_name, "wb");
   if (file == NULL) {
     log_error("Could not open file for writing");
     exit(EXIT_FAILURE);
   }
 
-  unsigned int trash_size = calculate_trash_size(content, file_size, codes);
-  unsigned int tree_size = calculate_tree_size(root);
+  unsigned int tree_size = 0;
+  if (format == FORMAT_CANONICAL) {
+    unsigned char lengths[ASCII_SIZE];
+    get_code_lengths(codes, lengths);
+    write_canonical_header(file, FORMAT_CANONICAL, 0, lengths);
+  } else {
+    tree_size = calculate_tree_size(tree, tree->root);
+    write_trash_and_size(file, 0, tree_size);
+    write_tree(file, tree, tree->root);
+  }
+
+  unsigned char* buffer = malloc(IO_BUFFER_SIZE * sizeof(unsigned char));
+  if (!buffer) {
+    log_error("Could not allocate memory for output buffer");
+    exit(EXIT_FAILURE);
+  }
 
-  write_trash_and_size(file, trash_size, tree_size);
-  write_tree(file, root);
+  bit_writer_t writer;
+  init_bit_writer(&writer, file, buffer, IO_BUFFER_SIZE);
 
-  unsigned char buffer = 0;
-  int bit_count = 0;
   for (size_t i = 0; i < file_size; i++) {
-    unsigned char byte = content[i];
-    char* code = codes[byte];
-
-    for (size_t j = 0; j < strlen(code); j++) {
-      buffer <<= 1;
-      if (code[j] == '1') {
-        buffer |= 1;
-      }
-      bit_count++;
+    put_code(&writer, &codes[content[i]]);
+  }
 
-      if (bit_count == 8) {
-        fwrite(&buffer, sizeof(unsigned char), 1, file);
-        buffer = 0;
-        bit_count = 0;
-      }
-    }
+  unsigned int trash_size = finish_bit_writer(&writer);
+  if (writer.failed) {
+    log_error("Could not write compressed data");
+    exit(EXIT_FAILURE);
   }
 
-  if (bit_count > 0) {
-    buffer <<= (8 - bit_count);
-    fwrite(&buffer, sizeof(unsigned char), 1, file);
+  if (format == FORMAT_CANONICAL) {
+    unsigned char trash = (unsigned char)trash_size;
+    fseek(file, 3, SEEK_SET);
+    fwrite(&trash, sizeof(unsigned char), 1, file);
+  } else {
+    fseek(file, 0, SEEK_SET);
+    write_trash_and_size(file, trash_size, tree_size);
   }
 
+  free(buffer);
   fclose(file);
 }
 
-char* ask_file_extension() {
-  char* file_extension = malloc(10 * sizeof(char));
-  if (file_extension == NULL) {
-    log_error("Could not allocate memory for file extension");
-    exit(EXIT_FAILURE);
+static void write_little_endian_64(unsigned char* bytes, uint64_t value) {
+  for (int i = 0; i < 8; i++) {
+    bytes[i] = (unsigned char)(value >> (8 * i));
   }
-
-  scanf(" %s", file_extension);
-
-  return file_extension;
-}
-
-void display_menu() {
-  printf("Select operation mode:\n");
-  printf("1. Compress file\n");
-  printf("2. Extract file\n");
-  printf("Enter your choice: ");
 }
 
-void read_header(FILE* file, unsigned int* trash_size,
-                 unsigned int* tree_size) {
-  unsigned short header;
-  if (fread(&header, sizeof(unsigned short), 1, file) != 1) {
-    log_error("Could not read header from file");
-    exit(EXIT_FAILURE);
+static uint64_t read_little_endian_64(const unsigned char* bytes) {
+  uint64_t value = 0;
+  for (int i = 7; i >= 0; i--) {
+    value = (value << 8) | bytes[i];
   }
-  *trash_size = (header >> 13) & 0x07;
-  *tree_size = header & 0x1FFF;
+  return value;
 }
 
-node_t* reconstruct_tree(FILE* file) {
-  unsigned char byte;
-  if (fread(&byte, sizeof(unsigned char), 1, file) != 1) {
-    return NULL;
+static bool compress_stream(FILE* input_file, FILE* output_file, int max_length,
+                            stats_t* stats, const char** error) {
+  unsigned char* buffer = malloc(IO_BUFFER_SIZE * sizeof(unsigned char));
+  unsigned char* output = malloc(IO_BUFFER_SIZE * sizeof(unsigned char));
+  size_t frequencies[ASCII_SIZE] = {0};
+  if (!buffer || !output) {
+    *error = "Could not allocate memory for streaming compression";
+    free(buffer);
+    free(output);
+    return false;
   }
 
-  node_t* node = malloc(sizeof(node_t));
-  if (!node) {
-    log_error("Could not allocate memory for tree reconstruction");
-    return NULL;
-  }
+  input_t input;
+  open_input(&input, input_file);
+  input.stats = stats;
 
-  if (byte == '*') {
-    node->element = malloc(sizeof(unsigned char));
-    if (!node->element) {
-      log_error("Could not allocate memory for element in tree reconstruction");
-      free(node);
-      return NULL;
-    }
-    *(unsigned char*)node->element = byte;
-    node->left = reconstruct_tree(file);
-    node->right = reconstruct_tree(file);
-  } else if (byte == '\\') {
-    if (fread(&byte, sizeof(unsigned char), 1, file) != 1) {
-      free(node);
-      return NULL;
-    }
-    node->element = malloc(sizeof(unsigned char));
-    if (!node->element) {
-      log_error("Could not allocate memory for element in tree reconstruction");
-      free(node);
-      return NULL;
-    }
-    *(unsigned char*)node->element = byte;
-    node->left = NULL;
-    node->right = NULL;
-  } else {
-    node->element = malloc(sizeof(unsigned char));
-    if (!node->element) {
-      log_error("Could not allocate memory for element in tree reconstruction");
-      free(node);
-      return NULL;
+  FILE* spool = NULL;
+  long start = ftell(input_file);
+  if (!input.mapped &&
+      (start < 0 || fseek(input_file, start, SEEK_SET) != 0)) {
+    spool = tmpfile();
+    if (!spool) {
+      *error = "Could not create temporary file for streaming input";
+      close_input(&input);
+      free(buffer);
+      free(output);
+      return false;
     }
-    *(unsigned char*)node->element = byte;
-    node->left = NULL;
-    node->right = NULL;
   }
 
-  return node;
-}
-
-void decompress_data(FILE* input_file, FILE* output_file, node_t* root,
-                     unsigned int trash_size, long data_start_pos) {
-  node_t* current = root;
-  unsigned char byte;
-
-  fseek(input_file, 0, SEEK_END);
-  long file_size = ftell(input_file);
-  fseek(input_file, data_start_pos, SEEK_SET);
+  bool valid = true;
+  uint64_t total_size = 0;
+  size_t chunk_size;
+  const unsigned char* chunk =
+      read_chunk(&input, buffer, IO_BUFFER_SIZE, &chunk_size);
+  while (chunk_size > 0 && valid) {
+    enter_phase(stats, PHASE_HISTOGRAM);
+    count_frequencies(chunk, chunk_size, frequencies);
+    total_size += chunk_size;
+    enter_phase(stats, PHASE_READ);
+    if (spool && fwrite(chunk, sizeof(unsigned char), chunk_size, spool) !=
+                     chunk_size) {
+      *error = "Could not write temporary file for streaming input";
+      valid = false;
+    }
+    enter_phase(stats, PHASE_OTHER);
+    chunk = read_chunk(&input, buffer, IO_BUFFER_SIZE, &chunk_size);
+  }
 
-  long data_size = file_size - data_start_pos;
-  size_t bytes_read = 0;
+  if (input.mapped) {
+    input.position = (size_t)start;
+  } else if (spool) {
+    rewind(spool);
+    input.file = spool;
+  } else {
+    fseek(input_file, start, SEEK_SET);
+  }
 
-  while (fread(&byte, sizeof(unsigned char), 1, input_file)) {
-    bytes_read++;
-    int bits_to_read = (bytes_read == data_size) ? 8 - trash_size : 8;
+  enter_phase(stats, PHASE_TREE);
+  code_t codes[ASCII_SIZE] = {0};
+  if (valid && total_size > 0) {
+    tree_t tree;
+    package_merge_t* scratch = NULL;
+    init_tree(&tree);
+    if (!build_codes(&tree, frequencies, codes, true, max_length, &scratch)) {
+      *error = "Could not allocate memory for Huffman codes";
+      valid = false;
+    }
+    destroy_tree(&tree);
+    free(scratch);
+  }
+  enter_phase(stats, PHASE_OTHER);
 
-    for (int i = 7; i >= 8 - bits_to_read; i--) {
-      int bit = (byte >> i) & 1;
+  bit_writer_t writer;
+  init_bit_writer(&writer, output_file, output, IO_BUFFER_SIZE);
+  writer.stats = stats;
 
-      if (bit) {
-        current = current->right;
-      } else {
-        current = current->left;
-      }
+  if (valid) {
+    unsigned char lengths[ASCII_SIZE];
+    get_code_lengths(codes, lengths);
+    enter_phase(stats, PHASE_WRITE);
+    write_canonical_header(output_file, FORMAT_STREAM, 0, lengths);
+    enter_phase(stats, PHASE_OTHER);
 
-      if (current == NULL) {
-        log_error("Invalid Huffman tree path during decompression");
-        return;
+    chunk = read_chunk(&input, buffer, IO_BUFFER_SIZE, &chunk_size);
+    while (chunk_size > 0 && !writer.failed) {
+      enter_phase(stats, PHASE_ENCODE);
+      for (size_t i = 0; i < chunk_size; i++) {
+        put_code(&writer, &codes[chunk[i]]);
       }
+      enter_phase(stats, PHASE_OTHER);
+      chunk = read_chunk(&input, buffer, IO_BUFFER_SIZE, &chunk_size);
+    }
 
-      if (current->left == NULL && current->right == NULL) {
-        fwrite(current->element, sizeof(unsigned char), 1, output_file);
-        current = root;
-      }
+    unsigned char trailer[STREAM_TRAILER_SIZE];
+    trailer[STREAM_TRAILER_SIZE - 1] =
+        (unsigned char)finish_bit_writer(&writer);
+    write_little_endian_64(trailer, total_size);
+    enter_phase(stats, PHASE_WRITE);
+    if (writer.failed || !write_bytes(output_file, trailer, sizeof(trailer))) {
+      *error = "Could not write compressed data";
+      valid = false;
     }
+    enter_phase(stats, PHASE_OTHER);
   }
-}
 
-void extract_file(char* file_name) {
-  FILE* input_file = fopen(file_name, "rb");
-  if (!input_file) {
-    log_error("Could not open input file");
-    free(file_name);
-    return;
+  if (stats) {
+    stats->raw_bytes = total_size;
+    stats->packed_bytes = CANONICAL_HEADER_SIZE + (writer.total_bits + 7) / 8 +
+                          STREAM_TRAILER_SIZE;
   }
 
-  unsigned int trash_size, tree_size;
-  read_header(input_file, &trash_size, &tree_size);
+  close_input(&input);
+  if (spool) fclose(spool);
+  free(buffer);
+  free(output);
+  return valid;
+}
 
-  node_t* root = reconstruct_tree(input_file);
-  if (!root) {
-    log_error("Could not reconstruct Huffman tree");
-    fclose(input_file);
-    free(file_name);
-    return;
+static void write_little_endian_32(unsigned char* bytes, uint32_t value) {
+  for (int i = 0; i < 4; i++) {
+    bytes[i] = (unsigned char)(value >> (8 * i));
   }
+}
 
-  long data_start_pos = ftell(input_file);
+static uint32_t read_little_endian_32(const unsigned char* bytes) {
+  return (uint32_t)bytes[0] | (uint32_t)bytes[1] << 8 |
+         (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+}
+
+static bool reserve_buffer(unsigned char** buffer, size_t* capacity,
+                           size_t size) {
+  if (*capacity >= size) return true;
+
+  unsigned char* resized = realloc(*buffer, size);
+  if (!resized) return false;
+  *buffer = resized;
+  *capacity = size;
+  return true;
+}
+
+static int get_default_worker_count() {
+#ifdef _SC_NPROCESSORS_ONLN
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+  return count > 0 ? (int)count : 1;
+#else
+  return 1;
+#endif
+}
+
+static void run_pool_jobs(thread_pool_t* pool) {
+  while (pool->next_job < pool->job_count) {
+    size_t index = pool->next_job++;
+    pthread_mutex_unlock(&pool->mutex);
+    pool->job(pool->context, index);
+    pthread_mutex_lock(&pool->mutex);
+
+    if (++pool->finished_jobs == pool->job_count) {
+      pthread_cond_broadcast(&pool->work_done);
+    }
+  }
+}
+
+static void* thread_pool_worker(void* argument) {
+  thread_pool_t* pool = argument;
+  unsigned long seen_generation = 0;
+
+  pthread_mutex_lock(&pool->mutex);
+  while (true) {
+    while (!pool->stopping && pool->generation == seen_generation) {
+      pthread_cond_wait(&pool->work_ready, &pool->mutex);
+    }
+    if (pool->stopping) break;
+
+    seen_generation = pool->generation;
+    run_pool_jobs(pool);
+  }
+  pthread_mutex_unlock(&pool->mutex);
+
+  return NULL;
+}
+
+static thread_pool_t* create_thread_pool(int worker_count) {
+  int thread_count = worker_count > 1 ? worker_count - 1 : 0;
+  thread_pool_t* pool = calloc(1, sizeof(thread_pool_t));
+  pthread_t* threads = calloc(thread_count + 1, sizeof(pthread_t));
+  if (!pool || !threads) {
+    free(pool);
+    free(threads);
+    return NULL;
+  }
+
+  pthread_mutex_init(&pool->mutex, NULL);
+  pthread_cond_init(&pool->work_ready, NULL);
+  pthread_cond_init(&pool->work_done, NULL);
+
+  pool->threads = threads;
+  while (pool->thread_count < thread_count &&
+         pthread_create(&pool->threads[pool->thread_count], NULL,
+                        thread_pool_worker, pool) == 0) {
+    pool->thread_count++;
+  }
+
+  return pool;
+}
+
+static void thread_pool_run(thread_pool_t* pool, void (*job)(void*, size_t),
+                            void* context, size_t job_count) {
+  pthread_mutex_lock(&pool->mutex);
+  pool->job = job;
+  pool->context = context;
+  pool->job_count = job_count;
+  pool->next_job = 0;
+  pool->finished_jobs = 0;
+  pool->generation++;
+  pthread_cond_broadcast(&pool->work_ready);
+
+  run_pool_jobs(pool);
+  while (pool->finished_jobs < pool->job_count) {
+    pthread_cond_wait(&pool->work_done, &pool->mutex);
+  }
+  pthread_mutex_unlock(&pool->mutex);
+}
+
+static void destroy_thread_pool(thread_pool_t* pool) {
+  pthread_mutex_lock(&pool->mutex);
+  pool->stopping = true;
+  pthread_cond_broadcast(&pool->work_ready);
+  pthread_mutex_unlock(&pool->mutex);
+
+  for (int i = 0; i < pool->thread_count; i++) {
+    pthread_join(pool->threads[i], NULL);
+  }
+
+  pthread_mutex_destroy(&pool->mutex);
+  pthread_cond_destroy(&pool->work_ready);
+  pthread_cond_destroy(&pool->work_done);
+  free(pool->threads);
+  free(pool);
+}
+
+static uint32_t crc32c_table[8][ASCII_SIZE];
+static pthread_once_t crc32c_once = PTHREAD_ONCE_INIT;
+static bool crc32c_hardware = false;
+
+static void init_crc32c() {
+  for (uint32_t byte = 0; byte < ASCII_SIZE; byte++) {
+    uint32_t crc = byte;
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (CRC32C_POLYNOMIAL & (0u - (crc & 1)));
+    }
+    crc32c_table[0][byte] = crc;
+  }
+
+  for (uint32_t byte = 0; byte < ASCII_SIZE; byte++) {
+    for (int slice = 1; slice < 8; slice++) {
+      uint32_t previous = crc32c_table[slice - 1][byte];
+      crc32c_table[slice][byte] =
+          (previous >> 8) ^ crc32c_table[0][previous & 0xFF];
+    }
+  }
+
+#ifdef HAVE_CRC32C_HARDWARE
+  crc32c_hardware = __builtin_cpu_supports("sse4.2");
+#endif
+}
+
+static uint32_t update_crc32c_software(uint32_t crc, const unsigned char* data,
+                                       size_t size) {
+  size_t byte = 0;
+  for (; byte + 8 <= size; byte += 8) {
+    uint32_t low = read_little_endian_32(data + byte) ^ crc;
+    uint32_t high = read_little_endian_32(data + byte + 4);
+    crc = crc32c_table[7][low & 0xFF] ^ crc32c_table[6][(low >> 8) & 0xFF] ^
+          crc32c_table[5][(low >> 16) & 0xFF] ^ crc32c_table[4][low >> 24] ^
+          crc32c_table[3][high & 0xFF] ^ crc32c_table[2][(high >> 8) & 0xFF] ^
+          crc32c_table[1][(high >> 16) & 0xFF] ^ crc32c_table[0][high >> 24];
+  }
+
+  for (; byte < size; byte++) {
+    crc = (crc >> 8) ^ crc32c_table[0][(crc ^ data[byte]) & 0xFF];
+  }
+  return crc;
+}
+
+#ifdef HAVE_CRC32C_HARDWARE
+__attribute__((target("sse4.2"))) static uint32_t update_crc32c_hardware(
+    uint32_t crc, const unsigned char* data, size_t size) {
+  uint64_t value = crc;
+  size_t byte = 0;
+  for (; byte + 8 <= size; byte += 8) {
+    uint64_t word;
+    memcpy(&word, data + byte, sizeof(uint64_t));
+    value = _mm_crc32_u64(value, word);
+  }
+
+  crc = (uint32_t)value;
+  for (; byte < size; byte++) {
+    crc = _mm_crc32_u8(crc, data[byte]);
+  }
+  return crc;
+}
+#endif
+
+static uint32_t compute_crc32c(const unsigned char* data, size_t size) {
+  pthread_once(&crc32c_once, init_crc32c);
+
+#ifdef HAVE_CRC32C_HARDWARE
+  if (crc32c_hardware) return ~update_crc32c_hardware(~0u, data, size);
+#endif
+  return ~update_crc32c_software(~0u, data, size);
+}
+
+static void release_block_job(block_job_t* job) {
+  free(job->input);
+  free(job->output);
+  free(job->table);
+  free(job->lookup_table);
+  free(job->context_counts);
+  free(job->context_lengths);
+  free(job->context_codes);
+  free(job->context_tables);
+  free(job->package_merge);
+  destroy_tree(&job->tree);
+}
+
+static void free_block_jobs(block_job_t* jobs, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    release_block_job(&jobs[i]);
+  }
+  free(jobs);
+}
+
+static size_t get_packed_lengths_size(const unsigned char* lengths) {
+  size_t count = 0;
+  for (int symbol = 0; symbol < ASCII_SIZE; symbol++) {
+    count += lengths[symbol] != 0;
+  }
+  return CONTEXT_BITMAP_SIZE + (count + 1) / 2;
+}
+
+static size_t pack_lengths(const unsigned char* lengths,
+                           unsigned char* output) {
+  size_t size = CONTEXT_BITMAP_SIZE;
+  size_t count = 0;
+  memset(output, 0, CONTEXT_BITMAP_SIZE);
+
+  for (int symbol = 0; symbol < ASCII_SIZE; symbol++) {
+    if (lengths[symbol] == 0) continue;
+
+    output[symbol / 8] |= (unsigned char)(1 << (symbol % 8));
+    if (count++ % 2 == 0) {
+      output[size] = lengths[symbol];
+    } else {
+      output[size++] |= (unsigned char)(lengths[symbol] << 4);
+    }
+  }
+  return size + count % 2;
+}
+
+static size_t unpack_lengths(const unsigned char* input, size_t size,
+                             unsigned char* lengths) {
+  if (size < CONTEXT_BITMAP_SIZE) return 0;
+
+  size_t position = CONTEXT_BITMAP_SIZE;
+  size_t count = 0;
+  for (int symbol = 0; symbol < ASCII_SIZE; symbol++) {
+    lengths[symbol] = 0;
+    if (!(input[symbol / 8] & (1 << (symbol % 8)))) continue;
+
+    if (position == size) return 0;
+    if (count++ % 2 == 0) {
+      lengths[symbol] = input[position] & 0x0F;
+    } else {
+      lengths[symbol] = input[position++] >> 4;
+    }
+    if (lengths[symbol] == 0) return 0;
+  }
+  return position + count % 2;
+}
+
+static bool get_context_lengths(block_job_t* job, const size_t* frequencies,
+                                int max_length, unsigned char* lengths) {
+  if (!limit_code_lengths(frequencies, max_length, lengths,
+                          &job->package_merge)) {
+    return false;
+  }
+
+  for (int symbol = 0; symbol < ASCII_SIZE; symbol++) {
+    if (frequencies[symbol] != 0 && lengths[symbol] == 0) lengths[symbol] = 1;
+  }
+  return true;
+}
+
+static bool allocate_context_buffers(block_job_t* job) {
+  if (!job->context_counts) {
+    job->context_counts = malloc(ASCII_SIZE * ASCII_SIZE * sizeof(uint32_t));
+  }
+  if (!job->context_lengths) {
+    job->context_lengths = malloc(ASCII_SIZE * ASCII_SIZE);
+  }
+  if (!job->context_codes) {
+    job->context_codes = malloc(ASCII_SIZE * ASCII_SIZE * sizeof(uint16_t));
+  }
+  return job->context_counts && job->context_lengths && job->context_codes;
+}
+
+static void pack_context_codes(const unsigned char* lengths, uint16_t* row) {
+  code_t codes[ASCII_SIZE];
+  generate_canonical_codes(lengths, codes);
+  for (int symbol = 0; symbol < ASCII_SIZE; symbol++) {
+    row[symbol] = (uint16_t)(codes[symbol].bits << 4 | codes[symbol].length);
+  }
+}
+
+static bool compress_context_block(block_job_t* job, const code_t* order0_codes,
+                                   uint64_t limit_bits, bool* packed) {
+  *packed = false;
+  if (!allocate_context_buffers(job)) return false;
+  uint32_t* counts = job->context_counts;
+
+  enter_phase(&job->stats, PHASE_HISTOGRAM);
+  memset(counts, 0, ASCII_SIZE * ASCII_SIZE * sizeof(uint32_t));
+  unsigned char previous = 0;
+  for (size_t i = 0; i < job->source_size; i++) {
+    counts[previous * ASCII_SIZE + job->source[i]]++;
+    previous = job->source[i];
+  }
+
+  enter_phase(&job->stats, PHASE_TREE);
+  int max_length = job->max_code_length < LOOKUP_TABLE_BITS
+                       ? job->max_code_length
+                       : LOOKUP_TABLE_BITS;
+  uint64_t savings[ASCII_SIZE] = {0};
+  int own_count = 0;
+  int cheapest = 0;
+
+  for (int context = 0; context < ASCII_SIZE; context++) {
+    const uint32_t* row = &counts[context * ASCII_SIZE];
+    unsigned char* lengths = &job->context_lengths[context * ASCII_SIZE];
+    size_t frequencies[ASCII_SIZE];
+    size_t total = 0;
+    for (int symbol = 0; symbol < ASCII_SIZE; symbol++) {
+      frequencies[symbol] = row[symbol];
+      total += row[symbol];
+    }
+    if (total < CONTEXT_MIN_COUNT) continue;
+
+    if (!get_context_lengths(job, frequencies, max_length, lengths)) {
+      return false;
+    }
+    uint64_t own_bits = 8 * get_packed_lengths_size(lengths);
+    uint64_t shared_bits = 0;
+    for (int symbol = 0; symbol < ASCII_SIZE; symbol++) {
+      own_bits += (uint64_t)row[symbol] * lengths[symbol];
+      shared_bits += (uint64_t)row[symbol] * order0_codes[symbol].length;
+    }
+
+    if (own_bits < shared_bits) {
+      savings[context] = shared_bits - own_bits;
+      if (own_count == 0 || savings[context] < savings[cheapest]) {
+        cheapest = context;
+      }
+      own_count++;
+    }
+  }
+  if (own_count == ASCII_SIZE) savings[cheapest] = 0;
+  if (own_count == 0) return true;
+
+  unsigned char* map = job->lengths;
+  size_t shared[ASCII_SIZE] = {0};
+  int bucket_count = 1;
+  for (int context = 0; context < ASCII_SIZE; context++) {
+    map[context] = 0;
+    if (savings[context] > 0) {
+      map[context] = (unsigned char)bucket_count++;
+      continue;
+    }
+    for (int symbol = 0; symbol < ASCII_SIZE; symbol++) {
+      shared[symbol] += counts[context * ASCII_SIZE + symbol];
+    }
+  }
+
+  unsigned char shared_lengths[ASCII_SIZE];
+  if (!get_context_lengths(job, shared, max_length, shared_lengths)) {
+    return false;
+  }
+
+  size_t model_size = 1 + get_packed_lengths_size(shared_lengths);
+  uint64_t total_bits = 0;
+  const uint16_t* rows[ASCII_SIZE];
+  pack_context_codes(shared_lengths, job->context_codes);
+  for (int context = 0; context < ASCII_SIZE; context++) {
+    const unsigned char* lengths = shared_lengths;
+    uint16_t* row = &job->context_codes[map[context] * ASCII_SIZE];
+    rows[context] = row;
+    if (map[context]) {
+      lengths = &job->context_lengths[context * ASCII_SIZE];
+      pack_context_codes(lengths, row);
+      model_size += get_packed_lengths_size(lengths);
+    }
+
+    for (int symbol = 0; symbol < ASCII_SIZE; symbol++) {
+      total_bits +=
+          (uint64_t)counts[context * ASCII_SIZE + symbol] * lengths[symbol];
+    }
+  }
+  if (model_size + (total_bits + 7) / 8 >= (limit_bits + 7) / 8) return true;
+
+  enter_phase(&job->stats, PHASE_ENCODE);
+  if (!reserve_buffer(&job->output, &job->output_capacity,
+                      model_size + total_bits / 8 + 8)) {
+    return false;
+  }
+  unsigned char* output = job->output;
+  output[0] = (unsigned char)(bucket_count - 1);
+  size_t size = 1 + pack_lengths(shared_lengths, output + 1);
+  for (int context = 0; context < ASCII_SIZE; context++) {
+    if (map[context] == 0) continue;
+    size += pack_lengths(&job->context_lengths[context * ASCII_SIZE],
+                         output + size);
+  }
+
+  bit_writer_t writer;
+  init_bit_writer(&writer, NULL, output + size, SIZE_MAX);
+  previous = 0;
+  for (size_t i = 0; i < job->source_size; i++) {
+    uint16_t code = rows[previous][job->source[i]];
+    put_bits(&writer, code >> 4, code & 0x0F);
+    previous = job->source[i];
+  }
+
+  job->block_type = BLOCK_TYPE_CONTEXT;
+  job->trash_size = finish_bit_writer(&writer);
+  job->target = output;
+  job->target_size = size + writer.size;
+  *packed = true;
+  return true;
+}
+
+static void store_block(block_job_t* job) {
+  memset(job->lengths, 0, ASCII_SIZE);
+  job->block_type = BLOCK_TYPE_STORED;
+  job->trash_size = 0;
+  job->target = (unsigned char*)job->source;
+  job->target_size = job->source_size;
+}
+
+static bool encode_huffman_block(block_job_t* job, const code_t* codes,
+                                 uint64_t total_bits) {
+  enter_phase(&job->stats, PHASE_ENCODE);
+  get_code_lengths(codes, job->lengths);
+  if (!reserve_buffer(&job->output, &job->output_capacity,
+                      total_bits / 8 + 8)) {
+    return false;
+  }
+
+  bit_writer_t writer;
+  init_bit_writer(&writer, NULL, job->output, SIZE_MAX);
+  for (size_t i = 0; i < job->source_size; i++) {
+    put_code(&writer, &codes[job->source[i]]);
+  }
+
+  job->block_type = BLOCK_TYPE_HUFFMAN;
+  job->trash_size = finish_bit_writer(&writer);
+  job->target = job->output;
+  job->target_size = writer.size;
+  return true;
+}
+
+static bool encode_interleaved_block(block_job_t* job,
+                                     const size_t* frequencies, code_t* codes,
+                                     uint64_t total_bits) {
+  unsigned char lengths[ASCII_SIZE];
+  get_code_lengths(codes, lengths);
+  for (int symbol = 0; symbol < ASCII_SIZE; symbol++) {
+    if (lengths[symbol] <= LOOKUP_TABLE_BITS) continue;
+
+    if (!limit_code_lengths(frequencies, LOOKUP_TABLE_BITS, lengths,
+                            &job->package_merge)) {
+      return false;
+    }
+    generate_canonical_codes(lengths, codes);
+    total_bits = 0;
+    for (int i = 0; i < ASCII_SIZE; i++) {
+      total_bits += (uint64_t)frequencies[i] * lengths[i];
+    }
+    break;
+  }
+  if (total_bits / 8 + INTERLEAVED_JUMP_SIZE + INTERLEAVED_STREAMS +
+          BLOCK_HEADER_SIZE - STORED_HEADER_SIZE >=
+      job->source_size) {
+    store_block(job);
+    return true;
+  }
+
+  enter_phase(&job->stats, PHASE_ENCODE);
+  memcpy(job->lengths, lengths, ASCII_SIZE);
+  if (!reserve_buffer(&job->output, &job->output_capacity,
+                      total_bits / 8 + INTERLEAVED_JUMP_SIZE +
+                          INTERLEAVED_STREAMS)) {
+    return false;
+  }
+
+  size_t quarter = (job->source_size + INTERLEAVED_STREAMS - 1) /
+                   INTERLEAVED_STREAMS;
+  size_t size = INTERLEAVED_JUMP_SIZE;
+  for (int stream = 0; stream < INTERLEAVED_STREAMS; stream++) {
+    size_t start = stream * quarter;
+    size_t end = start + quarter;
+    if (start > job->source_size) start = job->source_size;
+    if (end > job->source_size) end = job->source_size;
+
+    bit_writer_t writer;
+    init_bit_writer(&writer, NULL, job->output + size, SIZE_MAX);
+    for (size_t i = start; i < end; i++) {
+      put_code(&writer, &codes[job->source[i]]);
+    }
+    finish_bit_writer(&writer);
+
+    if (stream < INTERLEAVED_STREAMS - 1) {
+      write_little_endian_32(job->output + 4 * stream, (uint32_t)writer.size);
+    }
+    size += writer.size;
+  }
+
+  job->block_type = BLOCK_TYPE_INTERLEAVED;
+  job->trash_size = 0;
+  job->target = job->output;
+  job->target_size = size;
+  return true;
+}
+
+static bool pack_block(block_job_t* job, const size_t* frequencies) {
+  code_t codes[ASCII_SIZE];
+  if (!build_codes(&job->tree, frequencies, codes, true, job->max_code_length,
+                   &job->package_merge)) {
+    return false;
+  }
+
+  uint64_t total_bits = 0;
+  for (int i = 0; i < ASCII_SIZE; i++) {
+    total_bits += (uint64_t)frequencies[i] * codes[i].length;
+  }
+
+  uint64_t stored_bits = 8 * (uint64_t)job->source_size;
+  uint64_t table_bits = 8 * (BLOCK_HEADER_SIZE - STORED_HEADER_SIZE);
+  uint64_t budget_bits =
+      stored_bits > table_bits ? stored_bits - table_bits : 0;
+  uint64_t limit_bits = total_bits < budget_bits ? total_bits : budget_bits;
+  bool packed = false;
+  if (job->context_model &&
+      !compress_context_block(job, codes, limit_bits, &packed)) {
+    return false;
+  }
+
+  if (packed) return true;
+  if (total_bits >= budget_bits) {
+    store_block(job);
+    return true;
+  }
+  if (job->interleaved) {
+    return encode_interleaved_block(job, frequencies, codes, total_bits);
+  }
+  return encode_huffman_block(job, codes, total_bits);
+}
+
+static void compress_block_job(void* context, size_t index) {
+  block_job_t* job = &((block_job_t*)context)[index];
+  size_t frequencies[ASCII_SIZE] = {0};
+
+  start_stats(&job->stats);
+  enter_phase(&job->stats, PHASE_HISTOGRAM);
+  count_frequencies(job->source, job->source_size, frequencies);
+  enter_phase(&job->stats, PHASE_TREE);
+  job->status =
+      pack_block(job, frequencies) ? HUFFMAN_OK : HUFFMAN_ERROR_MEMORY;
+
+  if (job->status == HUFFMAN_OK) {
+    enter_phase(&job->stats, PHASE_CHECKSUM);
+    job->checksum = compute_crc32c(job->source, job->source_size);
+  }
+  enter_phase(&job->stats, PHASE_OTHER);
+}
+
+static size_t format_block_header(const block_job_t* job,
+                                  unsigned char* header) {
+  write_little_endian_32(header, (uint32_t)job->source_size);
+  header[4] =
+      (unsigned char)(job->trash_size | job->block_type << BLOCK_TYPE_SHIFT);
+  size_t size = STORED_HEADER_SIZE;
+  if (job->block_type != BLOCK_TYPE_STORED) {
+    write_little_endian_32(header + 5, (uint32_t)job->target_size);
+    memcpy(header + 9, job->lengths, ASCII_SIZE);
+    size = BLOCK_HEADER_SIZE;
+  }
+  write_little_endian_32(header + size, job->checksum);
+  return size + BLOCK_CHECKSUM_SIZE;
+}
+
+static bool compress_blocks(FILE* input_file, FILE* output_file,
+                            int worker_count, int max_length, size_t block_size,
+                            bool context_model, bool interleaved,
+                            stats_t* stats, const char** error) {
+  size_t batch_size = (size_t)worker_count * BLOCK_BATCH_FACTOR;
+  block_job_t* jobs = calloc(batch_size, sizeof(block_job_t));
+  thread_pool_t* pool = jobs ? create_thread_pool(worker_count) : NULL;
+  if (!pool) {
+    *error = "Could not allocate memory for block jobs";
+    free(jobs);
+    return false;
+  }
+
+  input_t input;
+  open_input(&input, input_file);
+  input.stats = stats;
+
+  uint64_t* block_offsets = NULL;
+  size_t block_count = 0;
+  size_t offsets_capacity = 0;
+
+  unsigned char header[8] = {'H', 'F', FORMAT_BLOCKS, BLOCK_FLAGS};
+  write_little_endian_32(header + 4, (uint32_t)block_size);
+  bool valid = write_bytes(output_file, header, sizeof(header));
+  if (!valid) *error = "Could not write compressed data";
+  uint64_t offset = sizeof(header);
+
+  bool more_input = valid;
+  while (more_input) {
+    size_t job_count = 0;
+    while (job_count < batch_size) {
+      block_job_t* job = &jobs[job_count];
+      job->max_code_length = max_length;
+      job->context_model = context_model;
+      job->interleaved = interleaved;
+      if (!input.mapped &&
+          !reserve_buffer(&job->input, &job->input_capacity, block_size)) {
+        *error = "Could not allocate memory for block buffer";
+        valid = more_input = false;
+        break;
+      }
+      job->source =
+          read_chunk(&input, job->input, block_size, &job->source_size);
+      if (job->source_size == 0) {
+        more_input = false;
+        break;
+      }
+
+      job_count++;
+      if (job->source_size < block_size) {
+        more_input = false;
+        break;
+      }
+    }
+    if (!valid) break;
+
+    thread_pool_run(pool, compress_block_job, jobs, job_count);
+
+    enter_phase(stats, PHASE_WRITE);
+    for (size_t i = 0; i < job_count && valid; i++) {
+      block_job_t* job = &jobs[i];
+      merge_stats(stats, &job->stats);
+      if (job->status != HUFFMAN_OK) {
+        *error = huffman_get_status_message(job->status);
+        valid = false;
+        break;
+      }
+      if (stats) stats->raw_bytes += job->source_size;
+
+      if (block_count == offsets_capacity) {
+        size_t capacity = offsets_capacity ? offsets_capacity * 2 : 64;
+        uint64_t* offsets =
+            realloc(block_offsets, capacity * sizeof(uint64_t));
+        if (!offsets) {
+          *error = "Could not allocate memory for block index";
+          valid = false;
+          break;
+        }
+        block_offsets = offsets;
+        offsets_capacity = capacity;
+      }
+      block_offsets[block_count++] = offset;
+
+      unsigned char block_header[BLOCK_HEADER_SIZE + BLOCK_CHECKSUM_SIZE];
+      size_t header_size = format_block_header(job, block_header);
+
+      if (!write_bytes(output_file, block_header, header_size) ||
+          !write_bytes(output_file, job->target, job->target_size)) {
+        *error = "Could not write compressed data";
+        valid = false;
+      }
+      offset += header_size + job->target_size;
+    }
+    enter_phase(stats, PHASE_OTHER);
+    more_input &= valid;
+  }
+
+  if (valid) {
+    enter_phase(stats, PHASE_WRITE);
+    unsigned char field[8] = {0};
+    valid = write_bytes(output_file, field, 4);
+    uint64_t index_offset = offset + 4;
+
+    for (size_t i = 0; i < block_count && valid; i++) {
+      write_little_endian_64(field, block_offsets[i]);
+      valid = write_bytes(output_file, field, 8);
+    }
+    write_little_endian_64(field, index_offset);
+    valid = valid && write_bytes(output_file, field, 8);
+    write_little_endian_64(field, block_count);
+    valid = valid && write_bytes(output_file, field, 8);
+    enter_phase(stats, PHASE_OTHER);
+    if (!valid) *error = "Could not write compressed data";
+    if (stats) stats->packed_bytes = index_offset + 8 * block_count + 16;
+  }
+
+  close_input(&input);
+  destroy_thread_pool(pool);
+  free_block_jobs(jobs, batch_size);
+  free(block_offsets);
+  return valid;
+}
+
+static const unsigned char* read_available(input_t* input,
+                                           unsigned char* buffer,
+                                           size_t max_size, size_t* size) {
+#ifndef _WIN32
+  if (!input->mapped) {
+    phase_t previous = enter_phase(input->stats, PHASE_READ);
+    ssize_t count;
+    do {
+      count = read(fileno(input->file), buffer, max_size);
+    } while (count < 0 && errno == EINTR);
+    enter_phase(input->stats, previous);
+
+    *size = count > 0 ? (size_t)count : 0;
+    return count < 0 ? NULL : buffer;
+  }
+#endif
+  return read_chunk(input, buffer, max_size, size);
+}
+
+static void init_adaptive_tree(adaptive_tree_t* tree) {
+  for (int symbol = 0; symbol < ASCII_SIZE; symbol++) {
+    tree->leaves[symbol] = NO_CHILD;
+  }
+
+  tree->nyt = ADAPTIVE_ROOT;
+  tree->nodes[ADAPTIVE_ROOT].left = NO_CHILD;
+  tree->nodes[ADAPTIVE_ROOT].right = NO_CHILD;
+  tree->nodes[ADAPTIVE_ROOT].symbol = 0;
+  tree->parents[ADAPTIVE_ROOT] = NO_CHILD;
+  tree->weights[ADAPTIVE_ROOT] = 0;
+}
+
+static void relink_adaptive_node(adaptive_tree_t* tree, uint16_t index) {
+  const node_t* node = &tree->nodes[index];
+  if (node->left != NO_CHILD) {
+    tree->parents[node->left] = index;
+    tree->parents[node->right] = index;
+  } else if (index != tree->nyt) {
+    tree->leaves[node->symbol] = index;
+  }
+}
+
+static void swap_adaptive_nodes(adaptive_tree_t* tree, uint16_t first,
+                                uint16_t second) {
+  node_t node = tree->nodes[first];
+  tree->nodes[first] = tree->nodes[second];
+  tree->nodes[second] = node;
+
+  uint64_t weight = tree->weights[first];
+  tree->weights[first] = tree->weights[second];
+  tree->weights[second] = weight;
+
+  relink_adaptive_node(tree, first);
+  relink_adaptive_node(tree, second);
+}
+
+static void update_adaptive_tree(adaptive_tree_t* tree, unsigned char symbol) {
+  uint16_t current = tree->leaves[symbol];
+
+  if (current == NO_CHILD) {
+    uint16_t parent = tree->nyt;
+    uint16_t leaf = parent - 1;
+    uint16_t nyt = parent - 2;
+
+    tree->nodes[parent].left = nyt;
+    tree->nodes[parent].right = leaf;
+    tree->nodes[leaf].left = NO_CHILD;
+    tree->nodes[leaf].right = NO_CHILD;
+    tree->nodes[leaf].symbol = symbol;
+    tree->nodes[nyt].left = NO_CHILD;
+    tree->nodes[nyt].right = NO_CHILD;
+    tree->parents[leaf] = parent;
+    tree->parents[nyt] = parent;
+    tree->weights[leaf] = 0;
+    tree->weights[nyt] = 0;
+    tree->leaves[symbol] = leaf;
+    tree->nyt = nyt;
+    current = leaf;
+  }
+
+  while (current != NO_CHILD) {
+    uint16_t leader = current;
+    while (leader < ADAPTIVE_ROOT &&
+           tree->weights[leader + 1] == tree->weights[current]) {
+      leader++;
+    }
+
+    if (leader != current && leader != tree->parents[current]) {
+      swap_adaptive_nodes(tree, current, leader);
+      current = leader;
+    }
+
+    tree->weights[current]++;
+    current = tree->parents[current];
+  }
+}
+
+static void put_adaptive_path(bit_writer_t* writer, const adaptive_tree_t* tree,
+                              uint16_t index) {
+  unsigned char path[ADAPTIVE_NODES];
+  int depth = 0;
+
+  while (index != ADAPTIVE_ROOT) {
+    uint16_t parent = tree->parents[index];
+    path[depth++] = tree->nodes[parent].right == index;
+    index = parent;
+  }
+
+  while (depth > 0) {
+    uint64_t bits = 0;
+    int length = 0;
+    while (depth > 0 && length < 32) {
+      bits = (bits << 1) | path[--depth];
+      length++;
+    }
+    put_bits(writer, bits, length);
+  }
+}
+
+static void drain_bit_writer(bit_writer_t* writer) {
+  while (writer->count >= 8) {
+    writer->buffer[writer->size++] =
+        (unsigned char)(writer->bits >> (writer->count - 8));
+    writer->count -= 8;
+  }
+  flush_bit_writer_buffer(writer);
+}
+
+static bool compress_adaptive(FILE* input_file, FILE* output_file,
+                              stats_t* stats, const char** error) {
+  unsigned char* buffer = malloc(IO_BUFFER_SIZE * sizeof(unsigned char));
+  unsigned char* output = malloc(IO_BUFFER_SIZE * sizeof(unsigned char));
+  adaptive_tree_t* tree = malloc(sizeof(adaptive_tree_t));
+  if (!buffer || !output || !tree) {
+    *error = "Could not allocate memory for adaptive compression";
+    free(buffer);
+    free(output);
+    free(tree);
+    return false;
+  }
+
+  setvbuf(input_file, NULL, _IONBF, 0);
+  input_t input;
+  open_input(&input, input_file);
+  input.stats = stats;
+
+  init_adaptive_tree(tree);
+
+  unsigned char header[4] = {'H', 'F', FORMAT_ADAPTIVE, 0};
+  bit_writer_t writer;
+  init_bit_writer(&writer, output_file, output, IO_BUFFER_SIZE);
+  writer.stats = stats;
+  writer.failed = !write_bytes(output_file, header, sizeof(header));
+
+  uint64_t total_size = 0;
+  size_t chunk_size;
+  const unsigned char* chunk =
+      read_available(&input, buffer, IO_BUFFER_SIZE, &chunk_size);
+  while (chunk_size > 0 && !writer.failed) {
+    enter_phase(stats, PHASE_ENCODE);
+    for (size_t i = 0; i < chunk_size; i++) {
+      unsigned char symbol = chunk[i];
+      if (tree->leaves[symbol] != NO_CHILD) {
+        put_adaptive_path(&writer, tree, tree->leaves[symbol]);
+      } else {
+        put_adaptive_path(&writer, tree, tree->nyt);
+        put_bits(&writer, 0, 1);
+        put_bits(&writer, symbol, 8);
+      }
+      update_adaptive_tree(tree, symbol);
+    }
+    total_size += chunk_size;
+
+    drain_bit_writer(&writer);
+    enter_phase(stats, PHASE_WRITE);
+    fflush(output_file);
+    enter_phase(stats, PHASE_OTHER);
+    chunk = read_available(&input, buffer, IO_BUFFER_SIZE, &chunk_size);
+  }
+
+  put_adaptive_path(&writer, tree, tree->nyt);
+  put_bits(&writer, 1, 1);
+  finish_bit_writer(&writer);
+
+  bool valid = chunk && !writer.failed;
+  if (!chunk) {
+    *error = "Could not read input";
+  } else if (writer.failed) {
+    *error = "Could not write compressed data";
+  }
+  if (stats) {
+    stats->raw_bytes = total_size;
+    stats->packed_bytes = sizeof(header) + (writer.total_bits + 7) / 8;
+  }
+
+  close_input(&input);
+  free(buffer);
+  free(output);
+  free(tree);
+  return valid;
+}
+
+static char* ask_file_extension() {
+  char* file_extension = malloc(10 * sizeof(char));
+  if (file_extension == NULL) {
+    log_error("Could not allocate memory for file extension");
+    exit(EXIT_FAILURE);
+  }
+
+  scanf(" %s", file_extension);
+
+  return file_extension;
+}
+
+static void display_menu() {
+  printf("Select operation mode:\n");
+  printf("1. Compress file\n");
+  printf("2. Extract file\n");
+  printf("3. Compress file (canonical Huffman)\n");
+  printf("4. Compress file (streaming)\n");
+  printf("5. Compress file (parallel blocks)\n");
+  printf("6. Compress file (adaptive)\n");
+  printf("Enter your choice: ");
+}
+
+static bool read_header(input_t* input, unsigned int* format,
+                        unsigned int* trash_size, unsigned int* tree_size) {
+  unsigned char bytes[2];
+  if (read_input(input, bytes, 2) != 2) return false;
+
+  if (bytes[0] == 'H' && bytes[1] == 'F') {
+    unsigned char fields[2];
+    if (read_input(input, fields, 2) != 2) return false;
+    *format = fields[0];
+    *trash_size = fields[1] & 0x07;
+    *tree_size = 0;
+    return true;
+  }
+
+  unsigned short header;
+  memcpy(&header, bytes, sizeof(unsigned short));
+  *format = FORMAT_TREE;
+  *trash_size = (header >> 13) & 0x07;
+  *tree_size = header & 0x1FFF;
+  return true;
+}
+
+static bool build_canonical_tree(const unsigned char* lengths, tree_t* tree) {
+  code_t codes[ASCII_SIZE];
+  if (!generate_canonical_codes(lengths, codes)) return false;
+
+  return build_tree_from_codes(codes, tree);
+}
+
+static bool read_canonical_tree(input_t* input, tree_t* tree) {
+  unsigned char lengths[ASCII_SIZE];
+  if (read_input(input, lengths, ASCII_SIZE) != ASCII_SIZE) {
+    return false;
+  }
+
+  return build_canonical_tree(lengths, tree);
+}
+
+static uint16_t reconstruct_node(input_t* input, tree_t* tree) {
+  unsigned char byte;
+  if (read_input(input, &byte, 1) != 1) {
+    return NO_CHILD;
+  }
+
+  if (byte == '\\') {
+    if (read_input(input, &byte, 1) != 1) return NO_CHILD;
+  } else if (byte == '*') {
+    if (tree->count >= 2 * ASCII_SIZE - 1) return NO_CHILD;
+
+    uint16_t index = add_node(tree, NO_CHILD, NO_CHILD, byte);
+    uint16_t left = reconstruct_node(input, tree);
+    if (left == NO_CHILD) return NO_CHILD;
+    uint16_t right = reconstruct_node(input, tree);
+    if (right == NO_CHILD) return NO_CHILD;
+
+    tree->nodes[index].left = left;
+    tree->nodes[index].right = right;
+    return index;
+  }
+
+  if (tree->count >= 2 * ASCII_SIZE - 1) return NO_CHILD;
+  return add_node(tree, NO_CHILD, NO_CHILD, byte);
+}
+
+static bool reconstruct_tree(input_t* input, tree_t* tree) {
+  if (!reserve_tree(tree, 2 * ASCII_SIZE - 1)) return false;
+  tree->root = reconstruct_node(input, tree);
+  return tree->root != NO_CHILD;
+}
+
+static void build_decode_table(decode_entry_t* table, const tree_t* tree) {
+  for (unsigned int index = 0; index < DECODE_TABLE_SIZE; index++) {
+    decode_entry_t* entry = &table[index];
+    uint16_t current = tree->root;
+    int used_bits = 0;
+
+    entry->count = 0;
+    entry->bits = 0;
+
+    for (int bit = DECODE_TABLE_BITS - 1; bit >= 0; bit--) {
+      const node_t* node = &tree->nodes[current];
+      current = ((index >> bit) & 1) ? node->right : node->left;
+      used_bits++;
+      if (current == NO_CHILD) break;
+
+      if (is_leaf(tree, current)) {
+        entry->symbols[entry->count++] = tree->nodes[current].symbol;
+        entry->bits = used_bits;
+        current = tree->root;
+        if (entry->count == DECODE_MAX_SYMBOLS) break;
+      }
+    }
+
+    entry->node = entry->count == 0 ? current : NO_CHILD;
+  }
+}
+
+static uint64_t read_big_endian_64(const unsigned char* bytes) {
+#ifdef HAVE_BYTE_SWAP
+  uint64_t value;
+  memcpy(&value, bytes, sizeof(value));
+  return __builtin_bswap64(value);
+#else
+  uint64_t value = 0;
+  for (int i = 0; i < 8; i++) {
+    value = (value << 8) | bytes[i];
+  }
+  return value;
+#endif
+}
+
+static void init_bit_reader(bit_reader_t* reader, FILE* file,
+                            unsigned char* buffer, unsigned int trash_size,
+                            size_t trailer_size) {
+  reader->file = file;
+  reader->buffer = buffer;
+  reader->size = 0;
+  reader->position = 0;
+  reader->held = 0;
+  reader->bits = 0;
+  reader->count = 0;
+  reader->trash_size = trash_size;
+  reader->trailer_size = trailer_size;
+  reader->end_of_file = false;
+  reader->truncated = false;
+  reader->stats = NULL;
+}
+
+static void init_memory_bit_reader(bit_reader_t* reader,
+                                   const unsigned char* data, size_t size,
+                                   unsigned int trash_size) {
+  init_bit_reader(reader, NULL, (unsigned char*)data, trash_size, 0);
+  reader->size = size;
+}
+
+static bool fill_bit_reader_buffer(bit_reader_t* reader) {
+  size_t bytes_read = 0;
+  if (reader->file != NULL) {
+    phase_t previous = enter_phase(reader->stats, PHASE_READ);
+    memmove(reader->buffer, reader->buffer + reader->size, reader->held);
+    bytes_read = fread(reader->buffer + reader->held, sizeof(unsigned char),
+                       IO_BUFFER_SIZE - reader->held, reader->file);
+    enter_phase(reader->stats, previous);
+  }
+  size_t total = reader->held + bytes_read;
+  reader->position = 0;
+
+  if (bytes_read == 0) {
+    if (reader->held != reader->trailer_size) {
+      reader->truncated = true;
+      reader->end_of_file = true;
+      reader->size = 0;
+      reader->count = 0;
+      return false;
+    }
+    memcpy(reader->trailer, reader->buffer, reader->held);
+    if (reader->trailer_size > 0) {
+      reader->trash_size = reader->trailer[reader->trailer_size - 1] & 0x07;
+    }
+
+    reader->size = 0;
+    reader->held = 0;
+    reader->end_of_file = true;
+    reader->count = reader->count > (int)reader->trash_size
+                        ? reader->count - (int)reader->trash_size
+                        : 0;
+    return false;
+  }
+
+  reader->held =
+      total < reader->trailer_size ? total : reader->trailer_size;
+  reader->size = total - reader->held;
+  return true;
+}
+
+static void refill_bit_reader(bit_reader_t* reader) {
+  if (reader->size - reader->position >= 8) {
+    reader->bits |=
+        read_big_endian_64(reader->buffer + reader->position) >> reader->count;
+    reader->position += (63 - reader->count) >> 3;
+    reader->count |= 56;
+    return;
+  }
+
+  while (reader->count <= 56) {
+    if (reader->position == reader->size) {
+      if (reader->end_of_file || !fill_bit_reader_buffer(reader)) return;
+
+      if (reader->size >= 8) {
+        refill_bit_reader(reader);
+        return;
+      }
+      continue;
+    }
+
+    reader->bits |= (uint64_t)reader->buffer[reader->position++]
+                    << (56 - reader->count);
+    reader->count += 8;
+  }
+}
+
+static void consume_bits(bit_reader_t* reader, int bits) {
+  reader->bits <<= bits;
+  reader->count -= bits;
+}
+
+static bool walk_tree(bit_reader_t* reader, const tree_t* tree,
+                      uint16_t current, unsigned char* symbol) {
+  while (current != NO_CHILD) {
+    const node_t* node = &tree->nodes[current];
+    if (is_leaf(tree, current)) {
+      *symbol = node->symbol;
+      return true;
+    }
+
+    if (reader->count == 0) {
+      refill_bit_reader(reader);
+      if (reader->count == 0) return false;
+    }
+
+    current = (reader->bits >> 63) ? node->right : node->left;
+    consume_bits(reader, 1);
+  }
+
+  return false;
+}
+
+static void init_output_buffer(output_buffer_t* output, FILE* file,
+                               unsigned char* buffer, size_t capacity) {
+  output->file = file;
+  output->buffer = buffer;
+  output->size = 0;
+  output->capacity = capacity;
+  output->total = 0;
+  output->stats = NULL;
+}
+
+static bool flush_output(output_buffer_t* output) {
+  if (output->file == NULL) return false;
+
+  phase_t previous = enter_phase(output->stats, PHASE_WRITE);
+  bool written =
+      output->size == 0 || fwrite(output->buffer, sizeof(unsigned char),
+                                  output->size, output->file) == output->size;
+  enter_phase(output->stats, previous);
+  if (!written) return false;
+  output->total += output->size;
+  output->size = 0;
+  return true;
+}
+
+static bool decode_bits(bit_reader_t* reader, const decode_entry_t* table,
+                        const tree_t* tree, output_buffer_t* output) {
+  bool leaf_root = is_leaf(tree, tree->root);
+  size_t limit = output->capacity > DECODE_MAX_SYMBOLS
+                     ? output->capacity - DECODE_MAX_SYMBOLS
+                     : 0;
+
+  while (true) {
+    if (output->size > limit) {
+      if (output->file == NULL) break;
+      if (!flush_output(output)) return false;
+    }
+
+    refill_bit_reader(reader);
+    if (reader->count < DECODE_TABLE_BITS) break;
+
+    const decode_entry_t* entry =
+        &table[reader->bits >> (64 - DECODE_TABLE_BITS)];
+    if (entry->count > 0) {
+      memcpy(output->buffer + output->size, entry->symbols, DECODE_MAX_SYMBOLS);
+      output->size += entry->count;
+      consume_bits(reader, entry->bits);
+    } else {
+      consume_bits(reader, DECODE_TABLE_BITS);
+      if (!walk_tree(reader, tree, entry->node,
+                     &output->buffer[output->size])) {
+        return false;
+      }
+      output->size++;
+    }
+  }
+
+  refill_bit_reader(reader);
+  while (reader->count > 0 && !leaf_root) {
+    if (output->size == output->capacity && !flush_output(output)) {
+      return false;
+    }
+    if (!walk_tree(reader, tree, tree->root, &output->buffer[output->size])) {
+      return false;
+    }
+    output->size++;
+    refill_bit_reader(reader);
+  }
+
+  return true;
+}
+
+static bool decompress_data(input_t* input, FILE* output_file,
+                            const tree_t* tree,
+                            const decode_entry_t* shared_table,
+                            unsigned int trash_size, size_t trailer_size,
+                            const char** error) {
+  decode_entry_t* table =
+      shared_table ? NULL : malloc(DECODE_TABLE_SIZE * sizeof(decode_entry_t));
+  unsigned char* input_buffer =
+      input->mapped ? NULL : malloc(IO_BUFFER_SIZE * sizeof(unsigned char));
+  unsigned char* buffer = malloc(IO_BUFFER_SIZE * sizeof(unsigned char));
+  if ((!shared_table && !table) || (!input->mapped && !input_buffer) ||
+      !buffer) {
+    free(table);
+    free(input_buffer);
+    free(buffer);
+    *error = "Could not allocate memory for decompression";
+    return false;
+  }
+
+  stats_t* stats = input->stats;
+  if (!shared_table) {
+    enter_phase(stats, PHASE_TREE);
+    build_decode_table(table, tree);
+    enter_phase(stats, PHASE_OTHER);
+    shared_table = table;
+  }
+
+  bit_reader_t reader;
+  if (input->mapped) {
+    size_t remaining = input->size - input->position;
+    if (remaining < trailer_size) {
+      free(table);
+      free(buffer);
+      *error = "Compressed stream is truncated";
+      return false;
+    }
+
+    init_memory_bit_reader(&reader, input->data + input->position,
+                           remaining - trailer_size, trash_size);
+    if (trailer_size > 0) {
+      memcpy(reader.trailer, input->data + input->size - trailer_size,
+             trailer_size);
+      reader.trash_size = reader.trailer[trailer_size - 1] & 0x07;
+    }
+  } else {
+    init_bit_reader(&reader, input->file, input_buffer, trash_size,
+                    trailer_size);
+  }
+  reader.stats = stats;
+
+  output_buffer_t output;
+  init_output_buffer(&output, output_file, buffer, IO_BUFFER_SIZE);
+  output.stats = stats;
+
+  enter_phase(stats, PHASE_DECODE);
+  bool valid = decode_bits(&reader, shared_table, tree, &output);
+  enter_phase(stats, PHASE_OTHER);
+  bool written = flush_output(&output);
+  if (stats) stats->raw_bytes = output.total;
+
+  if (reader.truncated) {
+    *error = "Compressed stream is truncated";
+    valid = false;
+  } else if (!written) {
+    *error = "Could not write decompressed data";
+    valid = false;
+  } else if (!valid) {
+    *error = "Compressed data is corrupted";
+  } else if (trailer_size > 0 &&
+             read_little_endian_64(reader.trailer) != output.total) {
+    *error = "Decoded size does not match the stream trailer";
+    valid = false;
+  }
+
+  free(table);
+  free(input_buffer);
+  free(buffer);
+  return valid;
+}
+
+static bool build_lookup_table(const unsigned char* lengths, uint16_t* table) {
+  code_t codes[ASCII_SIZE];
+  for (int symbol = 0; symbol < ASCII_SIZE; symbol++) {
+    if (lengths[symbol] > LOOKUP_TABLE_BITS) return false;
+  }
+  if (!generate_canonical_codes(lengths, codes)) return false;
+
+  memset(table, 0, LOOKUP_TABLE_SIZE * sizeof(uint16_t));
+  for (int symbol = 0; symbol < ASCII_SIZE; symbol++) {
+    int length = codes[symbol].length;
+    if (length == 0) continue;
+
+    size_t first = (size_t)codes[symbol].bits
+                   << (LOOKUP_TABLE_BITS - length);
+    size_t count = (size_t)1 << (LOOKUP_TABLE_BITS - length);
+    for (size_t entry = first; entry < first + count; entry++) {
+      table[entry] = (uint16_t)(length << 8 | symbol);
+    }
+  }
+  return true;
+}
+
+static bool decompress_context_block(block_job_t* job) {
+  const unsigned char* model = job->source;
+  if (job->source_size == 0) return false;
+
+  size_t bucket_count = (size_t)model[0] + 1;
+  size_t position = 1;
+  for (int context = 0; context < ASCII_SIZE; context++) {
+    if (job->lengths[context] >= bucket_count) return false;
+  }
+
+  for (size_t bucket = 0; bucket < bucket_count; bucket++) {
+    unsigned char lengths[ASCII_SIZE];
+    uint16_t* table = &job->context_tables[bucket * LOOKUP_TABLE_SIZE];
+    size_t used = unpack_lengths(model + position, job->source_size - position,
+                                 lengths);
+    if (used == 0 || !build_lookup_table(lengths, table)) return false;
+    position += used;
+  }
+
+  const uint16_t* tables[ASCII_SIZE];
+  for (int context = 0; context < ASCII_SIZE; context++) {
+    tables[context] = &job->context_tables[job->lengths[context] *
+                                           LOOKUP_TABLE_SIZE];
+  }
+
+  enter_phase(&job->stats, PHASE_DECODE);
+  bit_reader_t reader;
+  init_memory_bit_reader(&reader, model + position,
+                         job->source_size - position, job->trash_size);
+
+  unsigned char previous = 0;
+  for (size_t i = 0; i < job->target_size; i++) {
+    if (reader.count < LOOKUP_TABLE_BITS) refill_bit_reader(&reader);
+
+    uint16_t entry =
+        tables[previous][reader.bits >> (64 - LOOKUP_TABLE_BITS)];
+    int length = entry >> 8;
+    if (length == 0 || length > reader.count) return false;
+
+    previous = (unsigned char)entry;
+    job->target[i] = previous;
+    consume_bits(&reader, length);
+  }
+  return true;
+}
+
+static bool decompress_huffman_block(block_job_t* job) {
+  if (!build_canonical_tree(job->lengths, &job->tree)) return false;
+
+  build_decode_table(job->table, &job->tree);
+  enter_phase(&job->stats, PHASE_DECODE);
+
+  bit_reader_t reader;
+  init_memory_bit_reader(&reader, job->source, job->source_size,
+                         job->trash_size);
+
+  output_buffer_t output;
+  init_output_buffer(&output, NULL, job->target, job->target_size);
+
+  return decode_bits(&reader, job->table, &job->tree, &output) &&
+         output.size == job->target_size;
+}
+
+static void reload_lookup_stream(lookup_stream_t* stream) {
+  stream->bits |= read_big_endian_64(stream->next) >> stream->count;
+  stream->next += (63 - stream->count) >> 3;
+  stream->count |= 56;
+}
+
+static void refill_lookup_stream(lookup_stream_t* stream) {
+  if (stream->end - stream->next >= 8) {
+    reload_lookup_stream(stream);
+    return;
+  }
+
+  while (stream->count <= 56 && stream->next < stream->end) {
+    stream->bits |= (uint64_t)*stream->next++ << (56 - stream->count);
+    stream->count += 8;
+  }
+}
+
+static uint16_t decode_lookup_symbol(lookup_stream_t* stream,
+                                     const uint16_t* table) {
+  uint16_t entry = table[stream->bits >> (64 - LOOKUP_TABLE_BITS)];
+  stream->bits <<= entry >> 8;
+  stream->count -= entry >> 8;
+  return entry;
+}
+
+static bool finish_lookup_stream(lookup_stream_t stream, const uint16_t* table,
+                                 unsigned char* output, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    if (stream.count < LOOKUP_TABLE_BITS) refill_lookup_stream(&stream);
+
+    uint16_t entry = decode_lookup_symbol(&stream, table);
+    if (entry < 0x100 || stream.count < 0) return false;
+    output[i] = (unsigned char)entry;
+  }
+  return 8 * (stream.end - stream.next) + stream.count < 8;
+}
+
+static bool open_lookup_stream(const block_job_t* job, int index,
+                               size_t* position, lookup_stream_t* stream) {
+  size_t size = job->source_size - *position;
+  if (index < INTERLEAVED_STREAMS - 1) {
+    size = read_little_endian_32(job->source + 4 * index);
+    if (size > job->source_size - *position) return false;
+  }
+
+  stream->next = job->source + *position;
+  stream->end = stream->next + size;
+  stream->bits = 0;
+  stream->count = 0;
+  *position += size;
+  return true;
+}
+
+static bool decompress_interleaved_block(block_job_t* job) {
+  if (job->source_size < INTERLEAVED_JUMP_SIZE) return false;
+
+  const uint16_t* table = job->lookup_table;
+  if (!build_lookup_table(job->lengths, job->lookup_table)) return false;
+
+  bool complete = true;
+  for (size_t entry = 0; entry < LOOKUP_TABLE_SIZE; entry++) {
+    complete &= table[entry] != 0;
+  }
+
+  size_t position = INTERLEAVED_JUMP_SIZE;
+  lookup_stream_t first, second, third, fourth;
+  if (!open_lookup_stream(job, 0, &position, &first) ||
+      !open_lookup_stream(job, 1, &position, &second) ||
+      !open_lookup_stream(job, 2, &position, &third) ||
+      !open_lookup_stream(job, 3, &position, &fourth)) {
+    return false;
+  }
+
+  size_t quarter = (job->target_size + INTERLEAVED_STREAMS - 1) /
+                   INTERLEAVED_STREAMS;
+  size_t starts[INTERLEAVED_STREAMS];
+  size_t counts[INTERLEAVED_STREAMS];
+  for (int stream = 0; stream < INTERLEAVED_STREAMS; stream++) {
+    size_t start = stream * quarter;
+    size_t end = start + quarter;
+    if (start > job->target_size) start = job->target_size;
+    if (end > job->target_size) end = job->target_size;
+    starts[stream] = start;
+    counts[stream] = end - start;
+  }
+
+  enter_phase(&job->stats, PHASE_DECODE);
+  unsigned char* output = job->target;
+  size_t done = 0;
+  while (complete &&
+         done + LOOKUP_RELOAD_SYMBOLS <= counts[INTERLEAVED_STREAMS - 1] &&
+         first.end - first.next >= 8 && second.end - second.next >= 8 &&
+         third.end - third.next >= 8 && fourth.end - fourth.next >= 8) {
+    reload_lookup_stream(&first);
+    reload_lookup_stream(&second);
+    reload_lookup_stream(&third);
+    reload_lookup_stream(&fourth);
+    for (int step = 0; step < LOOKUP_RELOAD_SYMBOLS; step++) {
+      output[done] = (unsigned char)decode_lookup_symbol(&first, table);
+      output[quarter + done] =
+          (unsigned char)decode_lookup_symbol(&second, table);
+      output[2 * quarter + done] =
+          (unsigned char)decode_lookup_symbol(&third, table);
+      output[3 * quarter + done] =
+          (unsigned char)decode_lookup_symbol(&fourth, table);
+      done++;
+    }
+  }
+
+  return finish_lookup_stream(first, table, output + starts[0] + done,
+                              counts[0] - done) &&
+         finish_lookup_stream(second, table, output + starts[1] + done,
+                              counts[1] - done) &&
+         finish_lookup_stream(third, table, output + starts[2] + done,
+                              counts[2] - done) &&
+         finish_lookup_stream(fourth, table, output + starts[3] + done,
+                              counts[3] - done);
+}
+
+static bool allocate_decode_table(block_job_t* job) {
+  if (job->block_type == BLOCK_TYPE_CONTEXT) {
+    if (!job->context_tables) {
+      job->context_tables =
+          malloc(ASCII_SIZE * LOOKUP_TABLE_SIZE * sizeof(uint16_t));
+    }
+    return job->context_tables != NULL;
+  }
+  if (job->block_type == BLOCK_TYPE_INTERLEAVED) {
+    if (!job->lookup_table) {
+      job->lookup_table = malloc(LOOKUP_TABLE_SIZE * sizeof(uint16_t));
+    }
+    return job->lookup_table != NULL;
+  }
+  if (job->block_type == BLOCK_TYPE_HUFFMAN) {
+    if (!job->table) {
+      job->table = malloc(DECODE_TABLE_SIZE * sizeof(decode_entry_t));
+    }
+    return job->table != NULL;
+  }
+  return true;
+}
+
+static void decompress_block_job(void* context, size_t index) {
+  block_job_t* job = &((block_job_t*)context)[index];
+
+  start_stats(&job->stats);
+  enter_phase(&job->stats, PHASE_TREE);
+  if (!allocate_decode_table(job)) {
+    job->status = HUFFMAN_ERROR_MEMORY;
+    enter_phase(&job->stats, PHASE_OTHER);
+    return;
+  }
+
+  bool valid;
+  if (job->block_type == BLOCK_TYPE_STORED) {
+    enter_phase(&job->stats, PHASE_DECODE);
+    valid = job->source_size == job->target_size;
+    if (valid) memcpy(job->target, job->source, job->target_size);
+  } else if (job->block_type == BLOCK_TYPE_CONTEXT) {
+    valid = decompress_context_block(job);
+  } else if (job->block_type == BLOCK_TYPE_INTERLEAVED) {
+    valid = decompress_interleaved_block(job);
+  } else {
+    valid = decompress_huffman_block(job);
+  }
+
+  if (valid && job->checksummed) {
+    enter_phase(&job->stats, PHASE_CHECKSUM);
+    valid = compute_crc32c(job->target, job->target_size) == job->checksum;
+  }
+  job->status = valid ? HUFFMAN_OK : HUFFMAN_ERROR_CORRUPT;
+  enter_phase(&job->stats, PHASE_OTHER);
+}
+
+static size_t get_block_type_offset(unsigned int flags) {
+  return flags & BLOCK_FLAG_COMPACT_STORED ? 4 : 8;
+}
+
+static bool is_compact_stored(const unsigned char* header, unsigned int flags) {
+  return (flags & BLOCK_FLAG_COMPACT_STORED) &&
+         header[4] >> BLOCK_TYPE_SHIFT == BLOCK_TYPE_STORED;
+}
+
+static size_t get_block_header_size(const unsigned char* header,
+                                    unsigned int flags) {
+  size_t size = is_compact_stored(header, flags) ? STORED_HEADER_SIZE
+                                                 : BLOCK_HEADER_SIZE;
+  return size + (flags & BLOCK_FLAG_CHECKSUM ? BLOCK_CHECKSUM_SIZE : 0);
+}
+
+static uint32_t get_block_payload_size(const unsigned char* header,
+                                       unsigned int flags) {
+  if (is_compact_stored(header, flags)) return read_little_endian_32(header);
+  return read_little_endian_32(header +
+                               (flags & BLOCK_FLAG_COMPACT_STORED ? 5 : 4));
+}
+
+static huffman_status_t read_block_header(input_t* input, block_job_t* job,
+                                          size_t block_size, unsigned int flags,
+                                          bool* end_of_blocks) {
+  unsigned char header[BLOCK_HEADER_SIZE + BLOCK_CHECKSUM_SIZE];
+  if (read_input(input, header, 4) != 4) return HUFFMAN_ERROR_TRUNCATED;
+
+  uint32_t raw_size = read_little_endian_32(header);
+  *end_of_blocks = raw_size == 0;
+  if (*end_of_blocks) return HUFFMAN_OK;
+
+  job->checksummed = (flags & BLOCK_FLAG_CHECKSUM) != 0;
+  size_t type_offset = get_block_type_offset(flags);
+  if (read_input(input, header + 4, type_offset - 3) != type_offset - 3) {
+    return HUFFMAN_ERROR_CORRUPT;
+  }
+  size_t header_size = get_block_header_size(header, flags);
+  size_t rest = header_size - type_offset - 1;
+  if (read_input(input, header + type_offset + 1, rest) != rest) {
+    return HUFFMAN_ERROR_CORRUPT;
+  }
+
+  uint32_t payload_size = get_block_payload_size(header, flags);
+  if (raw_size > block_size ||
+      payload_size > (uint64_t)raw_size * (MAX_CODE_LENGTH / 8) + 8) {
+    return HUFFMAN_ERROR_CORRUPT;
+  }
+
+  job->target_size = raw_size;
+  job->source_size = payload_size;
+  job->trash_size = header[type_offset] & 0x07;
+  job->block_type = header[type_offset] >> BLOCK_TYPE_SHIFT;
+  if (job->block_type > BLOCK_TYPE_INTERLEAVED) return HUFFMAN_ERROR_CORRUPT;
+  if (is_compact_stored(header, flags)) {
+    memset(job->lengths, 0, ASCII_SIZE);
+  } else {
+    memcpy(job->lengths, header + 9, ASCII_SIZE);
+  }
+  if (job->checksummed) {
+    job->checksum =
+        read_little_endian_32(header + header_size - BLOCK_CHECKSUM_SIZE);
+  }
+
+  if (input->mapped) {
+    if (input->size - input->position < payload_size) {
+      return HUFFMAN_ERROR_CORRUPT;
+    }
+    job->source = input->data + input->position;
+    input->position += payload_size;
+    return HUFFMAN_OK;
+  }
+
+  if (!reserve_buffer(&job->input, &job->input_capacity, payload_size)) {
+    return HUFFMAN_ERROR_MEMORY;
+  }
+  job->source = job->input;
+  return read_input(input, job->input, payload_size) == payload_size
+             ? HUFFMAN_OK
+             : HUFFMAN_ERROR_CORRUPT;
+}
+
+static bool read_block_index(const input_t* input, uint64_t* index_offset,
+                             uint64_t* block_count) {
+  if (!input->mapped || input->size < 16) return false;
+
+  *index_offset = read_little_endian_64(input->data + input->size - 16);
+  *block_count = read_little_endian_64(input->data + input->size - 8);
+  if (*index_offset < input->position + 4 ||
+      *index_offset > input->size - 16 ||
+      *block_count != (input->size - 16 - *index_offset) / 8) {
+    return false;
+  }
+
+  for (uint64_t i = 0; i < *block_count; i++) {
+    uint64_t offset =
+        read_little_endian_64(input->data + *index_offset + 8 * i);
+    if (offset < input->position || offset > *index_offset - 4) return false;
+  }
+  return true;
+}
+
+static uint64_t get_indexed_block_offset(const input_t* input,
+                                         uint64_t index_offset,
+                                         uint64_t block) {
+  return read_little_endian_64(input->data + index_offset + 8 * block);
+}
+
+static bool seek_block_range(input_t* input, const byte_range_t* range,
+                             uint64_t* skip, const char** error) {
+  uint64_t index_offset, block_count;
+  if (!read_block_index(input, &index_offset, &block_count)) {
+    *error = "Byte ranges need a seekable block archive with an index";
+    return false;
+  }
+
+  uint64_t start = 0;
+  for (uint64_t i = 0; i < block_count; i++) {
+    uint64_t offset = get_indexed_block_offset(input, index_offset, i);
+    uint64_t raw_size = read_little_endian_32(input->data + offset);
+    if (range->offset < start + raw_size) {
+      input->position = (size_t)offset;
+      *skip = range->offset - start;
+      return true;
+    }
+    start += raw_size;
+  }
+
+  if (range->offset != start) {
+    *error = "Byte range starts past the end of the archive";
+    return false;
+  }
+  input->position = (size_t)(index_offset - 4);
+  *skip = 0;
+  return true;
+}
+
+static unsigned char* map_block_output(input_t* input, FILE* output_file,
+                                       size_t* output_size) {
+#ifndef _WIN32
+  struct stat info;
+  uint64_t index_offset, block_count;
+  if (fstat(fileno(output_file), &info) != 0 || !S_ISREG(info.st_mode) ||
+      !read_block_index(input, &index_offset, &block_count)) {
+    return NULL;
+  }
+
+  uint64_t total_size = 0;
+  for (uint64_t i = 0; i < block_count; i++) {
+    uint64_t offset = get_indexed_block_offset(input, index_offset, i);
+    total_size += read_little_endian_32(input->data + offset);
+  }
+  if (total_size == 0 || total_size > SIZE_MAX) return NULL;
+
+  fflush(output_file);
+  if (ftruncate(fileno(output_file), (off_t)total_size) != 0) return NULL;
+
+  void* output = mmap(NULL, (size_t)total_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED, fileno(output_file), 0);
+  if (output == MAP_FAILED) return NULL;
+
+  *output_size = (size_t)total_size;
+  return output;
+#else
+  (void)input;
+  (void)output_file;
+  (void)output_size;
+  return NULL;
+#endif
+}
+
+static bool extract_blocks(input_t* input, FILE* output_file, int worker_count,
+                           unsigned int flags, const byte_range_t* range,
+                           const char** error) {
+  unsigned char field[4];
+  if (read_input(input, field, 4) != 4) {
+    *error = "Could not read block size";
+    return false;
+  }
+  size_t block_size = read_little_endian_32(field);
+  if (block_size == 0 || block_size > MAX_BLOCK_SIZE) {
+    *error = "Invalid block size";
+    return false;
+  }
+
+  uint64_t skip = 0;
+  uint64_t remaining = UINT64_MAX;
+  uint64_t wanted = UINT64_MAX;
+  if (range) {
+    if (!seek_block_range(input, range, &skip, error)) return false;
+    remaining = range->length;
+    if (remaining < UINT64_MAX - skip) wanted = skip + remaining;
+  }
+
+  size_t batch_size = (size_t)worker_count * BLOCK_BATCH_FACTOR;
+  block_job_t* jobs = calloc(batch_size, sizeof(block_job_t));
+  thread_pool_t* pool = jobs ? create_thread_pool(worker_count) : NULL;
+  if (!pool) {
+    *error = "Could not allocate memory for block jobs";
+    free(jobs);
+    return false;
+  }
+
+  size_t mapped_size = 0;
+  unsigned char* mapped_output =
+      range ? NULL : map_block_output(input, output_file, &mapped_size);
+  size_t written = 0;
+  uint64_t scheduled = 0;
+  uint64_t emitted = 0;
+
+  bool valid = true;
+  bool end_of_blocks = false;
+  while (valid && !end_of_blocks && scheduled < wanted) {
+    size_t job_count = 0;
+    while (job_count < batch_size && scheduled < wanted) {
+      block_job_t* job = &jobs[job_count];
+      huffman_status_t status =
+          read_block_header(input, job, block_size, flags, &end_of_blocks);
+      if (status == HUFFMAN_ERROR_MEMORY) {
+        *error = "Could not allocate memory for block buffer";
+        valid = false;
+        break;
+      }
+      if (status != HUFFMAN_OK ||
+          (mapped_output && !end_of_blocks &&
+           job->target_size > mapped_size - written)) {
+        *error = "Compressed block is truncated or corrupted";
+        valid = false;
+        break;
+      }
+      if (end_of_blocks) break;
+
+      if (mapped_output) {
+        job->target = mapped_output + written;
+      } else if (reserve_buffer(&job->output, &job->output_capacity,
+                                job->target_size)) {
+        job->target = job->output;
+      } else {
+        *error = "Could not allocate memory for block buffer";
+        valid = false;
+        break;
+      }
+      written += job->target_size;
+      scheduled += job->target_size;
+      job_count++;
+    }
+
+    if (!valid) break;
+
+    thread_pool_run(pool, decompress_block_job, jobs, job_count);
+
+    enter_phase(input->stats, PHASE_WRITE);
+    for (size_t i = 0; i < job_count && valid; i++) {
+      merge_stats(input->stats, &jobs[i].stats);
+      if (jobs[i].status == HUFFMAN_ERROR_MEMORY) {
+        *error = "Could not allocate memory for decode tables";
+        valid = false;
+        break;
+      }
+      if (jobs[i].status != HUFFMAN_OK) {
+        *error = "Compressed block is corrupted or fails its checksum";
+        valid = false;
+        break;
+      }
+      uint64_t size = jobs[i].target_size - skip;
+      if (size > remaining) size = remaining;
+      if (!mapped_output &&
+          !write_bytes(output_file, jobs[i].target + skip, (size_t)size)) {
+        *error = "Could not write decompressed data";
+        valid = false;
+        break;
+      }
+      remaining -= size;
+      emitted += size;
+      skip = 0;
+    }
+    enter_phase(input->stats, PHASE_OTHER);
+  }
+  if (input->stats) input->stats->raw_bytes = emitted;
+
+#ifndef _WIN32
+  if (mapped_output) {
+    munmap(mapped_output, mapped_size);
+    if (valid && written != mapped_size) {
+      *error = "Block index does not match the compressed blocks";
+      valid = false;
+    }
+  }
+#endif
+
+  destroy_thread_pool(pool);
+  free_block_jobs(jobs, batch_size);
+  return valid;
+}
+
+static bool decompress_adaptive(input_t* input, FILE* output_file,
+                                const char** error) {
+  unsigned char* input_buffer = malloc(IO_BUFFER_SIZE * sizeof(unsigned char));
+  unsigned char* buffer = malloc(IO_BUFFER_SIZE * sizeof(unsigned char));
+  adaptive_tree_t* tree = malloc(sizeof(adaptive_tree_t));
+  if (!input_buffer || !buffer || !tree) {
+    free(input_buffer);
+    free(buffer);
+    free(tree);
+    *error = "Could not allocate memory for adaptive decompression";
+    return false;
+  }
+
+  stats_t* stats = input->stats;
+  init_adaptive_tree(tree);
+
+  output_buffer_t output;
+  init_output_buffer(&output, output_file, buffer, IO_BUFFER_SIZE);
+  output.stats = stats;
+
+  uint16_t current = ADAPTIVE_ROOT;
+  bool reading_flag = true;
+  int literal_bits = -1;
+  unsigned int literal = 0;
+  bool finished = false;
+  bool written = true;
+
+  size_t chunk_size;
+  const unsigned char* chunk =
+      read_available(input, input_buffer, IO_BUFFER_SIZE, &chunk_size);
+  while (chunk_size > 0 && !finished && written) {
+    enter_phase(stats, PHASE_DECODE);
+    for (size_t i = 0; i < chunk_size && !finished && written; i++) {
+      for (int bit_index = 7; bit_index >= 0 && !finished && written;
+           bit_index--) {
+        unsigned int bit = (chunk[i] >> bit_index) & 1;
+
+        if (reading_flag) {
+          reading_flag = false;
+          finished = bit == 1;
+          literal_bits = 0;
+          literal = 0;
+          continue;
+        }
+
+        if (literal_bits >= 0) {
+          literal = (literal << 1) | bit;
+          if (++literal_bits < 8) continue;
+          literal_bits = -1;
+        } else {
+          const node_t* node = &tree->nodes[current];
+          current = bit ? node->right : node->left;
+          if (current == tree->nyt) {
+            reading_flag = true;
+            continue;
+          }
+          if (tree->nodes[current].left != NO_CHILD) continue;
+          literal = tree->nodes[current].symbol;
+        }
+
+        if (output.size == output.capacity && !flush_output(&output)) {
+          written = false;
+          continue;
+        }
+        output.buffer[output.size++] = (unsigned char)literal;
+        update_adaptive_tree(tree, (unsigned char)literal);
+        current = ADAPTIVE_ROOT;
+      }
+    }
+    enter_phase(stats, PHASE_OTHER);
+
+    written = written && flush_output(&output);
+    enter_phase(stats, PHASE_WRITE);
+    fflush(output_file);
+    enter_phase(stats, PHASE_OTHER);
+
+    if (!finished && written) {
+      chunk = read_available(input, input_buffer, IO_BUFFER_SIZE, &chunk_size);
+    }
+  }
+
+  if (!written) {
+    *error = "Could not write decompressed data";
+  } else if (!chunk) {
+    *error = "Could not read compressed data";
+  } else if (!finished) {
+    *error = "Adaptive stream is truncated";
+  }
+  if (stats) stats->raw_bytes = output.total;
+
+  free(input_buffer);
+  free(buffer);
+  free(tree);
+  return finished && written;
+}
+
+static uint32_t get_dictionary_id(const unsigned char* lengths) {
+  uint32_t hash = 2166136261u;
+  for (int i = 0; i < ASCII_SIZE; i++) {
+    hash = (hash ^ lengths[i]) * 16777619u;
+  }
+  return hash;
+}
+
+static bool train_dictionary(const char* dictionary_name,
+                             const char** sample_names, size_t sample_count,
+                             int max_length) {
+  size_t frequencies[ASCII_SIZE];
+  for (int symbol = 0; symbol < ASCII_SIZE; symbol++) {
+    frequencies[symbol] = 1;
+  }
+
+  unsigned char* buffer = malloc(IO_BUFFER_SIZE * sizeof(unsigned char));
+  if (!buffer) {
+    log_error("Could not allocate memory for dictionary training");
+    exit(EXIT_FAILURE);
+  }
+
+  for (size_t i = 0; i < sample_count; i++) {
+    bool from_stdin = strcmp(sample_names[i], "-") == 0;
+    FILE* sample = from_stdin ? stdin : fopen(sample_names[i], "rb");
+    if (!sample) {
+      log_file_error("Could not open sample file", sample_names[i]);
+      free(buffer);
+      return false;
+    }
+
+    input_t input;
+    open_input(&input, sample);
+    size_t chunk_size;
+    const unsigned char* chunk =
+        read_chunk(&input, buffer, IO_BUFFER_SIZE, &chunk_size);
+    while (chunk_size > 0) {
+      count_frequencies(chunk, chunk_size, frequencies);
+      chunk = read_chunk(&input, buffer, IO_BUFFER_SIZE, &chunk_size);
+    }
+    close_input(&input);
+    if (!from_stdin) fclose(sample);
+  }
+  free(buffer);
+
+  tree_t tree;
+  code_t codes[ASCII_SIZE];
+  package_merge_t* scratch = NULL;
+  init_tree(&tree);
+  if (!build_codes(&tree, frequencies, codes, true, max_length, &scratch)) {
+    log_error("Could not allocate memory for Huffman codes");
+    exit(EXIT_FAILURE);
+  }
+  destroy_tree(&tree);
+  free(scratch);
+
+  unsigned char header[DICTIONARY_FILE_SIZE] = {'H', 'F', 'D', 1};
+  get_code_lengths(codes, header + 8);
+  write_little_endian_32(header + 4, get_dictionary_id(header + 8));
+
+  FILE* file = fopen(dictionary_name, "wb");
+  if (!file) {
+    log_file_error("Could not create dictionary file", dictionary_name);
+    return false;
+  }
+  bool written = write_bytes(file, header, sizeof(header));
+  if (fclose(file) != 0 || !written) {
+    log_file_error("Could not write dictionary file", dictionary_name);
+    return false;
+  }
+  return true;
+}
+
+static bool load_dictionary(const char* dictionary_name,
+                            dictionary_t* dictionary) {
+  init_tree(&dictionary->tree);
+  dictionary->table = NULL;
+
+  FILE* file = fopen(dictionary_name, "rb");
+  if (!file) {
+    log_file_error("Could not open dictionary file", dictionary_name);
+    return false;
+  }
+
+  unsigned char header[DICTIONARY_FILE_SIZE];
+  size_t size = fread(header, sizeof(unsigned char), sizeof(header), file);
+  fclose(file);
+
+  const unsigned char* lengths = header + 8;
+  if (size != sizeof(header) || memcmp(header, "HFD\1", 4) != 0 ||
+      read_little_endian_32(header + 4) != get_dictionary_id(lengths) ||
+      !generate_canonical_codes(lengths, dictionary->codes) ||
+      !build_canonical_tree(lengths, &dictionary->tree)) {
+    log_file_error("Invalid dictionary file", dictionary_name);
+    destroy_tree(&dictionary->tree);
+    return false;
+  }
+
+  dictionary->id = read_little_endian_32(header + 4);
+  dictionary->table = malloc(DECODE_TABLE_SIZE * sizeof(decode_entry_t));
+  if (!dictionary->table) {
+    log_error("Could not allocate memory for decode table");
+    exit(EXIT_FAILURE);
+  }
+  build_decode_table(dictionary->table, &dictionary->tree);
+  return true;
+}
+
+static void free_dictionary(dictionary_t* dictionary) {
+  destroy_tree(&dictionary->tree);
+  free(dictionary->table);
+}
+
+static bool compress_with_dictionary(FILE* input_file, FILE* output_file,
+                                     const dictionary_t* dictionary,
+                                     stats_t* stats, const char** error) {
+  input_t input;
+  open_input(&input, input_file);
+  input.stats = stats;
+
+  unsigned char* content = NULL;
+  size_t capacity = 0;
+  size_t size = 0;
+  const unsigned char* data;
+  bool valid = true;
+  if (input.mapped) {
+    data = input.data + input.position;
+    size = input.size - input.position;
+  } else {
+    size_t chunk_size;
+    do {
+      if (!reserve_buffer(&content, &capacity, size + IO_BUFFER_SIZE)) {
+        *error = "Could not allocate memory for input buffer";
+        valid = false;
+        break;
+      }
+      read_chunk(&input, content + size, IO_BUFFER_SIZE, &chunk_size);
+      size += chunk_size;
+    } while (chunk_size > 0);
+    data = content;
+  }
+
+  enter_phase(stats, PHASE_ENCODE);
+  uint64_t total_bits = 0;
+  for (size_t i = 0; i < size && valid; i++) {
+    unsigned char length = dictionary->codes[data[i]].length;
+    if (length == 0) {
+      *error = "Input contains a byte the dictionary cannot encode";
+      valid = false;
+    }
+    total_bits += length;
+  }
+  enter_phase(stats, PHASE_OTHER);
+
+  unsigned char* buffer =
+      valid ? malloc(IO_BUFFER_SIZE * sizeof(unsigned char)) : NULL;
+  if (valid && !buffer) {
+    *error = "Could not allocate memory for output buffer";
+    valid = false;
+  }
+
+  if (valid) {
+    unsigned char header[DICTIONARY_HEADER_SIZE] = {'H', 'F',
+                                                    FORMAT_DICTIONARY};
+    header[3] = (unsigned char)((8 - total_bits % 8) % 8);
+    write_little_endian_32(header + 4, dictionary->id);
+
+    bit_writer_t writer;
+    init_bit_writer(&writer, output_file, buffer, IO_BUFFER_SIZE);
+    writer.stats = stats;
+    writer.failed = !write_bytes(output_file, header, sizeof(header));
+    enter_phase(stats, PHASE_ENCODE);
+    for (size_t i = 0; i < size; i++) {
+      put_code(&writer, &dictionary->codes[data[i]]);
+    }
+    finish_bit_writer(&writer);
+    enter_phase(stats, PHASE_OTHER);
+    if (writer.failed) {
+      *error = "Could not write compressed data";
+      valid = false;
+    }
+
+    if (stats) {
+      stats->raw_bytes = size;
+      stats->packed_bytes =
+          DICTIONARY_HEADER_SIZE + (writer.total_bits + 7) / 8;
+    }
+  }
+
+  close_input(&input);
+  free(content);
+  free(buffer);
+  return valid;
+}
+
+static bool decompress_with_dictionary(input_t* input, FILE* output_file,
+                                       unsigned int trash_size,
+                                       const dictionary_t* dictionary,
+                                       const char** error) {
+  unsigned char field[4];
+  if (read_input(input, field, sizeof(field)) != sizeof(field)) {
+    *error = "Could not read dictionary ID";
+    return false;
+  }
+
+  uint32_t id = read_little_endian_32(field);
+  if (!dictionary) {
+    *error = "Input needs a dictionary (use -D)";
+    return false;
+  }
+  if (id != dictionary->id) {
+    *error = "Input was compressed with a different dictionary";
+    return false;
+  }
+
+  return decompress_data(input, output_file, &dictionary->tree,
+                         dictionary->table, trash_size, 0, error);
+}
+
+static bool read_tree(input_t* input, unsigned int format, tree_t* tree) {
+  if (format == FORMAT_CANONICAL || format == FORMAT_STREAM) {
+    return read_canonical_tree(input, tree);
+  } else if (format == FORMAT_TREE) {
+    return reconstruct_tree(input, tree);
+  }
+  return false;
+}
+
+static bool extract_stream(FILE* input_file, FILE* output_file,
+                           int worker_count, const dictionary_t* dictionary,
+                           const byte_range_t* range, stats_t* stats,
+                           const char** error) {
+  setvbuf(input_file, NULL, _IONBF, 0);
+  input_t input;
+  open_input(&input, input_file);
+  input.stats = stats;
+
+  unsigned int format, trash_size, tree_size;
+  bool valid = false;
+  if (!read_header(&input, &format, &trash_size, &tree_size)) {
+    *error = "Could not read header from file";
+  } else if (format == FORMAT_BLOCKS) {
+    valid = extract_blocks(&input, output_file, worker_count, trash_size,
+                           range, error);
+  } else if (range) {
+    *error = "Byte ranges are only supported for block archives";
+  } else if (format == FORMAT_ADAPTIVE) {
+    valid = decompress_adaptive(&input, output_file, error);
+  } else if (format == FORMAT_DICTIONARY) {
+    valid = decompress_with_dictionary(&input, output_file, trash_size,
+                                       dictionary, error);
+  } else {
+    tree_t tree;
+    init_tree(&tree);
+    enter_phase(stats, PHASE_TREE);
+    bool tree_read = read_tree(&input, format, &tree);
+    enter_phase(stats, PHASE_OTHER);
+    if (tree_read) {
+      size_t trailer_size = format == FORMAT_STREAM ? STREAM_TRAILER_SIZE : 0;
+      valid = decompress_data(&input, output_file, &tree, NULL, trash_size,
+                              trailer_size, error);
+    } else {
+      *error = "Could not reconstruct Huffman tree";
+    }
+    destroy_tree(&tree);
+  }
+
+  if (stats) {
+    long position = ftell(input_file);
+    stats->packed_bytes =
+        input.mapped ? input.size : (position > 0 ? (uint64_t)position : 0);
+  }
+
+  close_input(&input);
+  return valid;
+}
+
+static void extract_file(char* file_name) {
+  FILE* input_file = fopen(file_name, "rb");
+  if (!input_file) {
+    log_error("Could not open input file");
+    free(file_name);
+    return;
+  }
 
   char* output_file_name = malloc(strlen(file_name) + 10);
   if (!output_file_name) {
     log_error("Could not allocate memory for output file name");
-    destroy_tree(root);
     free(file_name);
     fclose(input_file);
     return;
@@ -469,7 +3446,6 @@ void extract_file(char* file_name) {
   FILE* output_file = fopen(output_file_name, "wb");
   if (!output_file) {
     log_error("Could not create output file");
-    destroy_tree(root);
     free(output_file_name);
     free(extension);
     fclose(input_file);
@@ -477,30 +3453,843 @@ void extract_file(char* file_name) {
     return;
   }
 
-  decompress_data(input_file, output_file, root, trash_size, data_start_pos);
+  const char* error = NULL;
+  bool valid = extract_stream(input_file, output_file,
+                              get_default_worker_count(), NULL, NULL, NULL,
+                              &error);
 
-  destroy_tree(root);
   free(output_file_name);
   free(extension);
   fclose(input_file);
   fclose(output_file);
 
-  log_info("File extracted successfully");
+  if (valid) {
+    log_info("File extracted successfully");
+  } else {
+    log_error(error);
+  }
+}
+
+static void print_usage(const char* program) {
+  fprintf(stderr,
+          "Usage: %s [options] -c|-p|-a|-x [file...]\n"
+          "  -c                 compress (streaming format)\n"
+          "  -p                 compress in parallel blocks\n"
+          "  -a                 compress adaptively in a single pass\n"
+          "  -x                 extract any format\n"
+          "  -o FILE            write to FILE (single input only)\n"
+          "  -j N               number of worker threads\n"
+          "  --max-code-len N   limit codes to N bits (%d-%d, default %d)\n"
+          "  --block-size KIB   block size for -p (%d-%d KiB, default %d)\n"
+          "  --context          with -p, pick each byte's code table by the\n"
+          "                     byte before it when that is smaller\n"
+          "  --interleave       with -p, split each block into %d streams\n"
+          "                     that extract decodes side by side\n"
+          "  --range OFF[:LEN]  extract only LEN bytes from offset OFF of a\n"
+          "                     -p archive, verifying only the blocks read\n"
+          "  --train DICT       build dictionary DICT from the sample files\n"
+          "  -D DICT            with -c or -x, compress or extract with\n"
+          "                     dictionary DICT\n"
+          "  --stats            report per-phase timings on stderr\n"
+          "  --json             report the same timings as one JSON object\n"
+          "                     per file on stderr\n"
+          "Files are written next to their input with .huff added or "
+          "removed.\n"
+          "Without files, reads standard input and writes standard output.\n",
+          program, MIN_CODE_LENGTH_LIMIT, MAX_CODE_LENGTH,
+          DEFAULT_MAX_CODE_LENGTH, MIN_BLOCK_SIZE / 1024,
+          MAX_BLOCK_SIZE / 1024, BLOCK_SIZE / 1024, INTERLEAVED_STREAMS);
+}
+
+static bool parse_range(const char* text, byte_range_t* range) {
+  char* end;
+  errno = 0;
+  range->offset = strtoull(text, &end, 10);
+  range->length = UINT64_MAX;
+  if (end == text || errno != 0 || text[0] == '-') return false;
+  if (*end == '\0') return true;
+  if (*end != ':') return false;
+
+  text = end + 1;
+  range->length = strtoull(text, &end, 10);
+  return end != text && *end == '\0' && errno == 0 && text[0] != '-';
+}
+
+static char* get_output_name(const char* input_name, char action) {
+  size_t length = strlen(input_name);
+  char* output_name = malloc(length + 6);
+  if (!output_name) {
+    log_error("Could not allocate memory for output file name");
+    exit(EXIT_FAILURE);
+  }
+  strcpy(output_name, input_name);
+
+  if (action != 'x') {
+    strcat(output_name, ".huff");
+    return output_name;
+  }
+
+  if (length > 5 && strcmp(input_name + length - 5, ".huff") == 0) {
+    output_name[length - 5] = '\0';
+    return output_name;
+  }
+
+  free(output_name);
+  return NULL;
+}
+
+static void process_file_job(void* context, size_t index) {
+  file_job_t* job = &((file_job_t*)context)[index];
+  job->valid = false;
+  start_stats(&job->stats);
+
+  FILE* input_file = job->input_name ? fopen(job->input_name, "rb") : stdin;
+  if (!input_file) {
+    log_file_error("Could not open input file", job->input_name);
+    return;
+  }
+
+  FILE* output_file = job->output_name ? fopen(job->output_name, "wb") : stdout;
+  if (!output_file) {
+    log_file_error("Could not create output file", job->output_name);
+    if (job->input_name) fclose(input_file);
+    return;
+  }
+
+  const char* error = NULL;
+  if (job->action == 'c' && job->dictionary) {
+    job->valid = compress_with_dictionary(
+        input_file, output_file, job->dictionary, &job->stats, &error);
+  } else if (job->action == 'c') {
+    job->valid = compress_stream(input_file, output_file,
+                                 job->max_code_length, &job->stats, &error);
+  } else if (job->action == 'p') {
+    job->valid = compress_blocks(
+        input_file, output_file, job->worker_count, job->max_code_length,
+        job->block_size, job->context_model, job->interleaved, &job->stats,
+        &error);
+  } else if (job->action == 'a') {
+    job->valid =
+        compress_adaptive(input_file, output_file, &job->stats, &error);
+  } else {
+    job->valid =
+        extract_stream(input_file, output_file, job->worker_count,
+                       job->dictionary, job->range, &job->stats, &error);
+  }
+
+  if (job->input_name) fclose(input_file);
+  if (!job->valid) log_file_error(error, job->input_name);
+
+  enter_phase(&job->stats, PHASE_WRITE);
+  if ((job->output_name ? fclose(output_file) : fflush(output_file)) != 0) {
+    log_file_error("Could not write output file", job->output_name);
+    job->valid = false;
+  }
+  enter_phase(&job->stats, PHASE_OTHER);
+}
+
+static const char* const phase_names[PHASE_COUNT] = {
+    "other", "read", "histogram", "tree", "encode", "decode", "checksum",
+    "write"};
+
+static long get_peak_rss_kib() {
+#ifndef _WIN32
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+  return usage.ru_maxrss / 1024;
+#else
+  return usage.ru_maxrss;
+#endif
+#else
+  return 0;
+#endif
+}
+
+static void print_phase(const char* name, double seconds, uint64_t bytes) {
+  fprintf(stderr, "  %-10s %9.4f s", name, seconds);
+  if (seconds >= 1e-4 && bytes > 0) {
+    fprintf(stderr, " %10.1f MB/s", (double)bytes / seconds / 1e6);
+  }
+  fprintf(stderr, "\n");
+}
+
+static void print_stats(const file_job_t* job) {
+  const stats_t* stats = &job->stats;
+
+  fprintf(stderr, "%s -> %s: %llu -> %llu bytes",
+          job->input_name ? job->input_name : "-",
+          job->output_name ? job->output_name : "-",
+          (unsigned long long)(job->action == 'x' ? stats->packed_bytes
+                                                  : stats->raw_bytes),
+          (unsigned long long)(job->action == 'x' ? stats->raw_bytes
+                                                  : stats->packed_bytes));
+  if (stats->raw_bytes > 0 && stats->packed_bytes > 0) {
+    fprintf(stderr, " (%.1f%%)",
+            100.0 * (double)stats->packed_bytes / (double)stats->raw_bytes);
+  }
+  fprintf(stderr, "\n");
+
+  for (int phase = PHASE_READ; phase < PHASE_COUNT; phase++) {
+    if (job->action == 'x' && (phase == PHASE_HISTOGRAM ||
+                               phase == PHASE_ENCODE)) {
+      continue;
+    }
+    if (job->action != 'x' && phase == PHASE_DECODE) continue;
+    if (job->action == 'a' &&
+        (phase == PHASE_HISTOGRAM || phase == PHASE_TREE)) {
+      continue;
+    }
+
+    print_phase(phase_names[phase], stats->seconds[phase], stats->raw_bytes);
+  }
+  print_phase("total", stats->phase_start - stats->start_time,
+              stats->raw_bytes);
+  fprintf(stderr, "  %-10s %9ld KiB\n", "peak rss", get_peak_rss_kib());
+}
+
+static void print_json_string(const char* text) {
+  fputc('"', stderr);
+  for (const unsigned char* c = (const unsigned char*)text; *c; c++) {
+    if (*c == '"' || *c == '\\') {
+      fprintf(stderr, "\\%c", *c);
+    } else if (*c < 0x20) {
+      fprintf(stderr, "\\u%04x", *c);
+    } else {
+      fputc(*c, stderr);
+    }
+  }
+  fputc('"', stderr);
+}
+
+static void print_json_stats(const file_job_t* job) {
+  const stats_t* stats = &job->stats;
+  double seconds = stats->phase_start - stats->start_time;
+
+  fprintf(stderr, "{\"input\":");
+  print_json_string(job->input_name ? job->input_name : "-");
+  fprintf(stderr, ",\"output\":");
+  print_json_string(job->output_name ? job->output_name : "-");
+  fprintf(stderr,
+          ",\"action\":\"%c\",\"raw_bytes\":%llu,\"packed_bytes\":%llu,"
+          "\"ratio\":%.6f,\"seconds\":%.6f,\"mb_per_s\":%.3f,"
+          "\"peak_rss_kib\":%ld,\"phases\":{",
+          job->action, (unsigned long long)stats->raw_bytes,
+          (unsigned long long)stats->packed_bytes,
+          stats->raw_bytes > 0
+              ? (double)stats->packed_bytes / (double)stats->raw_bytes
+              : 0.0,
+          seconds, seconds > 0 ? (double)stats->raw_bytes / seconds / 1e6 : 0.0,
+          get_peak_rss_kib());
+  for (int phase = PHASE_READ; phase < PHASE_COUNT; phase++) {
+    fprintf(stderr, "%s\"%s\":%.6f", phase > PHASE_READ ? "," : "",
+            phase_names[phase], stats->seconds[phase]);
+  }
+  fprintf(stderr, "}}\n");
+}
+
+static int run_command_line(int argc, char** argv) {
+  int worker_count = get_default_worker_count();
+  int max_length = DEFAULT_MAX_CODE_LENGTH;
+  long block_kib = BLOCK_SIZE / 1024;
+  byte_range_t range;
+  bool has_range = false;
+  const char* output_name = NULL;
+  const char* dictionary_name = NULL;
+  bool show_stats = false;
+  bool json_stats = false;
+  bool context_model = false;
+  bool interleaved = false;
+  bool usage_error = false;
+  char action = 0;
+
+  const char** files = malloc(argc * sizeof(char*));
+  if (!files) {
+    log_error("Could not allocate memory for file list");
+    exit(EXIT_FAILURE);
+  }
+  size_t file_count = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+      worker_count = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--max-code-len") == 0 && i + 1 < argc) {
+      max_length = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--block-size") == 0 && i + 1 < argc) {
+      block_kib = atol(argv[++i]);
+    } else if (strcmp(argv[i], "--range") == 0 && i + 1 < argc) {
+      usage_error |= !parse_range(argv[++i], &range);
+      has_range = true;
+    } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      output_name = argv[++i];
+    } else if (strcmp(argv[i], "-D") == 0 && i + 1 < argc) {
+      dictionary_name = argv[++i];
+    } else if (strcmp(argv[i], "--train") == 0 && i + 1 < argc) {
+      usage_error |= action != 0 && action != 't';
+      action = 't';
+      dictionary_name = argv[++i];
+    } else if (strcmp(argv[i], "--stats") == 0) {
+      show_stats = true;
+    } else if (strcmp(argv[i], "--json") == 0) {
+      json_stats = true;
+    } else if (strcmp(argv[i], "--context") == 0) {
+      context_model = true;
+    } else if (strcmp(argv[i], "--interleave") == 0) {
+      interleaved = true;
+    } else if (strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "-p") == 0 ||
+               strcmp(argv[i], "-a") == 0 || strcmp(argv[i], "-x") == 0) {
+      usage_error |= action != 0 && action != argv[i][1];
+      action = argv[i][1];
+    } else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+      usage_error = true;
+    } else {
+      files[file_count++] = argv[i];
+    }
+  }
+
+  if (file_count == 0) files[file_count++] = "-";
+
+  bool reads_stdin = false;
+  for (size_t i = 0; i < file_count; i++) {
+    reads_stdin |= strcmp(files[i], "-") == 0;
+  }
+
+  if (dictionary_name && (action == 'p' || action == 'a')) {
+    log_error(action == 'p'
+                  ? "-D cannot be used with -p: every block stores its own "
+                    "code table, so use -c to compress with a dictionary"
+                  : "-D cannot be used with -a: adaptive coding learns its "
+                    "codes from the input, so use -c to compress with a "
+                    "dictionary");
+    free(files);
+    return EXIT_FAILURE;
+  }
+
+  if (usage_error || action == 0 || worker_count < 1 ||
+      max_length < MIN_CODE_LENGTH_LIMIT || max_length > MAX_CODE_LENGTH ||
+      block_kib < MIN_BLOCK_SIZE / 1024 || block_kib > MAX_BLOCK_SIZE / 1024 ||
+      (has_range && (action != 'x' || file_count > 1)) ||
+      ((context_model || interleaved) && action != 'p') ||
+      (file_count > 1 && (output_name || reads_stdin))) {
+    print_usage(argv[0]);
+    free(files);
+    return EXIT_FAILURE;
+  }
+
+#ifdef _WIN32
+  _setmode(_fileno(stdin), _O_BINARY);
+  _setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+  if (action == 't') {
+    bool trained =
+        train_dictionary(dictionary_name, files, file_count, max_length);
+    free(files);
+    return trained ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  dictionary_t dictionary;
+  if (dictionary_name && !load_dictionary(dictionary_name, &dictionary)) {
+    free(files);
+    return EXIT_FAILURE;
+  }
+
+  file_job_t* jobs = calloc(file_count, sizeof(file_job_t));
+  if (!jobs) {
+    log_error("Could not allocate memory for file jobs");
+    exit(EXIT_FAILURE);
+  }
+
+  bool valid = true;
+  size_t job_count = 0;
+  for (size_t i = 0; i < file_count; i++) {
+    file_job_t* job = &jobs[job_count];
+    job->input_name = strcmp(files[i], "-") == 0 ? NULL : files[i];
+    job->action = action;
+    job->worker_count = file_count > 1 ? 1 : worker_count;
+    job->max_code_length = max_length;
+    job->block_size = (size_t)block_kib * 1024;
+    job->context_model = context_model;
+    job->interleaved = interleaved;
+    job->range = has_range ? &range : NULL;
+    job->dictionary = dictionary_name ? &dictionary : NULL;
+
+    if (output_name) {
+      if (strcmp(output_name, "-") != 0) {
+        job->output_name = malloc(strlen(output_name) + 1);
+        if (!job->output_name) {
+          log_error("Could not allocate memory for output file name");
+          exit(EXIT_FAILURE);
+        }
+        strcpy(job->output_name, output_name);
+      }
+    } else if (job->input_name) {
+      job->output_name = get_output_name(job->input_name, action);
+      if (!job->output_name) {
+        log_file_error("Unknown suffix, expected .huff", job->input_name);
+        valid = false;
+        continue;
+      }
+    }
+    job_count++;
+  }
+
+  thread_pool_t* pool =
+      job_count > 1 ? create_thread_pool(worker_count < (int)job_count
+                                             ? worker_count
+                                             : (int)job_count)
+                    : NULL;
+  if (pool) {
+    thread_pool_run(pool, process_file_job, jobs, job_count);
+    destroy_thread_pool(pool);
+  } else {
+    for (size_t i = 0; i < job_count; i++) process_file_job(jobs, i);
+  }
+
+  for (size_t i = 0; i < job_count; i++) {
+    if (json_stats && jobs[i].valid) {
+      print_json_stats(&jobs[i]);
+    } else if (show_stats && jobs[i].valid) {
+      print_stats(&jobs[i]);
+    }
+    valid &= jobs[i].valid;
+    free(jobs[i].output_name);
+  }
+
+  if (dictionary_name) free_dictionary(&dictionary);
+  free(jobs);
+  free(files);
+  return valid ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+huffman_context_t* huffman_create_context(size_t block_size,
+                                          int max_code_length,
+                                          bool context_model) {
+  if (block_size == 0) block_size = BLOCK_SIZE;
+  if (max_code_length == 0) max_code_length = DEFAULT_MAX_CODE_LENGTH;
+  if (block_size < MIN_BLOCK_SIZE || block_size > MAX_BLOCK_SIZE ||
+      max_code_length < MIN_CODE_LENGTH_LIMIT ||
+      max_code_length > MAX_CODE_LENGTH) {
+    return NULL;
+  }
+
+  huffman_context_t* context = calloc(1, sizeof(huffman_context_t));
+  if (!context) return NULL;
+  context->block_size = block_size;
+  context->stream = STREAM_IDLE;
+
+  block_job_t* job = &context->job;
+  job->max_code_length = max_code_length;
+  job->context_model = context_model;
+  init_tree(&job->tree);
+  job->tree.nodes = malloc(2 * ASCII_SIZE * sizeof(node_t));
+  job->tree.capacity = job->tree.nodes ? 2 * ASCII_SIZE : 0;
+  job->package_merge = malloc(sizeof(package_merge_t));
+  job->table = malloc(DECODE_TABLE_SIZE * sizeof(decode_entry_t));
+  job->context_tables =
+      malloc(ASCII_SIZE * LOOKUP_TABLE_SIZE * sizeof(uint16_t));
+  if (context_model) {
+    job->context_counts = malloc(ASCII_SIZE * ASCII_SIZE * sizeof(uint32_t));
+    job->context_lengths = malloc(ASCII_SIZE * ASCII_SIZE);
+    job->context_codes = malloc(ASCII_SIZE * ASCII_SIZE * sizeof(uint16_t));
+  }
+
+  if (!job->tree.nodes || !job->package_merge || !job->table ||
+      !job->context_tables ||
+      (context_model && (!job->context_counts || !job->context_lengths ||
+                         !job->context_codes)) ||
+      !reserve_buffer(&job->output, &job->output_capacity, block_size + 8) ||
+      !reserve_buffer(&context->pending, &context->pending_capacity,
+                      block_size)) {
+    huffman_destroy_context(context);
+    return NULL;
+  }
+  return context;
+}
+
+void huffman_destroy_context(huffman_context_t* context) {
+  if (!context) return;
+
+  release_block_job(&context->job);
+  free(context->pending);
+  free(context->offsets);
+  free(context);
+}
+
+size_t huffman_compress_bound(const huffman_context_t* context, size_t size) {
+  size_t block_count = size / context->block_size + 1;
+  return 8 + block_count * (BLOCK_HEADER_SIZE + BLOCK_CHECKSUM_SIZE + 8) +
+         size + 4 + 16;
+}
+
+static huffman_status_t fail_stream(huffman_context_t* context,
+                                    huffman_status_t status) {
+  if (status != HUFFMAN_OK) context->stream = STREAM_IDLE;
+  return status;
+}
+
+static huffman_status_t emit_output(huffman_context_t* context,
+                                    const void* data, size_t size) {
+  if (!context->write(context->opaque, data, size)) return HUFFMAN_ERROR_WRITE;
+  context->offset += size;
+  return HUFFMAN_OK;
+}
+
+static bool write_memory_sink(void* opaque, const void* data, size_t size) {
+  memory_sink_t* sink = opaque;
+  if (size > sink->capacity - sink->size) {
+    sink->overflow = true;
+    return false;
+  }
+  if (size > 0) memcpy(sink->data + sink->size, data, size);
+  sink->size += size;
+  return true;
+}
+
+huffman_status_t huffman_begin_compress(huffman_context_t* context,
+                                        huffman_write_t write, void* opaque) {
+  if (!context || !write) return HUFFMAN_ERROR_ARGUMENT;
+  if (context->stream != STREAM_IDLE) return HUFFMAN_ERROR_STATE;
+
+  context->write = write;
+  context->opaque = opaque;
+  context->stream = STREAM_COMPRESSING;
+  context->pending_size = 0;
+  context->block_count = 0;
+  context->offset = 0;
+
+  unsigned char header[8] = {'H', 'F', FORMAT_BLOCKS, BLOCK_FLAGS};
+  write_little_endian_32(header + 4, (uint32_t)context->block_size);
+  return fail_stream(context, emit_output(context, header, sizeof(header)));
+}
+
+static huffman_status_t compress_context_chunk(huffman_context_t* context,
+                                               const unsigned char* data,
+                                               size_t size) {
+  if (context->block_count == context->offsets_capacity) {
+    size_t capacity =
+        context->offsets_capacity ? context->offsets_capacity * 2 : 64;
+    uint64_t* offsets =
+        realloc(context->offsets, capacity * sizeof(uint64_t));
+    if (!offsets) return HUFFMAN_ERROR_MEMORY;
+    context->offsets = offsets;
+    context->offsets_capacity = capacity;
+  }
+  context->offsets[context->block_count++] = context->offset;
+
+  block_job_t* job = &context->job;
+  job->source = data;
+  job->source_size = size;
+  compress_block_job(job, 0);
+  if (job->status != HUFFMAN_OK) return job->status;
+
+  unsigned char header[BLOCK_HEADER_SIZE + BLOCK_CHECKSUM_SIZE];
+  size_t header_size = format_block_header(job, header);
+  huffman_status_t status = emit_output(context, header, header_size);
+  if (status != HUFFMAN_OK) return status;
+  return emit_output(context, job->target, job->target_size);
+}
+
+huffman_status_t huffman_compress_chunk(huffman_context_t* context,
+                                        const void* data, size_t size) {
+  if (!context || (!data && size > 0)) return HUFFMAN_ERROR_ARGUMENT;
+  if (context->stream != STREAM_COMPRESSING) return HUFFMAN_ERROR_STATE;
+
+  const unsigned char* bytes = data;
+  size_t block_size = context->block_size;
+  while (size > 0) {
+    huffman_status_t status = HUFFMAN_OK;
+    if (context->pending_size == 0 && size >= block_size) {
+      status = compress_context_chunk(context, bytes, block_size);
+      bytes += block_size;
+      size -= block_size;
+    } else {
+      size_t count = block_size - context->pending_size;
+      if (count > size) count = size;
+      memcpy(context->pending + context->pending_size, bytes, count);
+      context->pending_size += count;
+      bytes += count;
+      size -= count;
+
+      if (context->pending_size == block_size) {
+        status = compress_context_chunk(context, context->pending, block_size);
+        context->pending_size = 0;
+      }
+    }
+    if (status != HUFFMAN_OK) return fail_stream(context, status);
+  }
+  return HUFFMAN_OK;
+}
+
+huffman_status_t huffman_finish_compress(huffman_context_t* context) {
+  if (!context) return HUFFMAN_ERROR_ARGUMENT;
+  if (context->stream != STREAM_COMPRESSING) return HUFFMAN_ERROR_STATE;
+
+  huffman_status_t status = HUFFMAN_OK;
+  if (context->pending_size > 0) {
+    status = compress_context_chunk(context, context->pending,
+                                    context->pending_size);
+    context->pending_size = 0;
+  }
+
+  unsigned char field[8] = {0};
+  if (status == HUFFMAN_OK) status = emit_output(context, field, 4);
+  uint64_t index_offset = context->offset;
+
+  for (size_t i = 0; i < context->block_count && status == HUFFMAN_OK; i++) {
+    write_little_endian_64(field, context->offsets[i]);
+    status = emit_output(context, field, 8);
+  }
+  if (status == HUFFMAN_OK) {
+    write_little_endian_64(field, index_offset);
+    status = emit_output(context, field, 8);
+  }
+  if (status == HUFFMAN_OK) {
+    write_little_endian_64(field, context->block_count);
+    status = emit_output(context, field, 8);
+  }
+
+  context->stream = STREAM_IDLE;
+  return status;
+}
+
+huffman_status_t huffman_compress(huffman_context_t* context,
+                                  const void* input, size_t input_size,
+                                  void* output, size_t output_capacity,
+                                  size_t* output_size) {
+  if (!output_size || (!output && output_capacity > 0)) {
+    return HUFFMAN_ERROR_ARGUMENT;
+  }
+
+  memory_sink_t sink = {output, 0, output_capacity, false};
+  huffman_status_t status =
+      huffman_begin_compress(context, write_memory_sink, &sink);
+  if (status == HUFFMAN_OK) {
+    status = huffman_compress_chunk(context, input, input_size);
+  }
+  if (status == HUFFMAN_OK) status = huffman_finish_compress(context);
+  if (sink.overflow) status = HUFFMAN_ERROR_BUFFER_TOO_SMALL;
+
+  *output_size = sink.size;
+  return status;
+}
+
+huffman_status_t huffman_get_extracted_size(const void* input,
+                                            size_t input_size,
+                                            uint64_t* extracted_size) {
+  if (!input || !extracted_size) return HUFFMAN_ERROR_ARGUMENT;
+
+  const unsigned char* bytes = input;
+  if (input_size < 8 || bytes[0] != 'H' || bytes[1] != 'F' ||
+      bytes[2] != FORMAT_BLOCKS) {
+    return HUFFMAN_ERROR_CORRUPT;
+  }
+
+  input_t archive = {.data = (unsigned char*)bytes,
+                     .size = input_size,
+                     .position = 8,
+                     .mapped = true};
+  uint64_t index_offset, block_count;
+  if (!read_block_index(&archive, &index_offset, &block_count)) {
+    return HUFFMAN_ERROR_CORRUPT;
+  }
+
+  *extracted_size = 0;
+  for (uint64_t i = 0; i < block_count; i++) {
+    uint64_t offset = get_indexed_block_offset(&archive, index_offset, i);
+    *extracted_size += read_little_endian_32(bytes + offset);
+  }
+  return HUFFMAN_OK;
+}
+
+huffman_status_t huffman_begin_extract(huffman_context_t* context,
+                                       huffman_write_t write, void* opaque) {
+  if (!context || !write) return HUFFMAN_ERROR_ARGUMENT;
+  if (context->stream != STREAM_IDLE) return HUFFMAN_ERROR_STATE;
+
+  context->write = write;
+  context->opaque = opaque;
+  context->stream = STREAM_EXTRACTING;
+  context->pending_size = 0;
+  context->block_count = 0;
+  context->offset = 0;
+  context->header_read = false;
+  context->end_of_blocks = false;
+  return HUFFMAN_OK;
+}
+
+static huffman_status_t parse_archive(huffman_context_t* context,
+                                      const unsigned char* data, size_t size,
+                                      size_t* consumed) {
+  block_job_t* job = &context->job;
+  size_t position = 0;
+  huffman_status_t status = HUFFMAN_OK;
+
+  while (status == HUFFMAN_OK && position < size) {
+    const unsigned char* bytes = data + position;
+    size_t available = size - position;
+
+    if (context->end_of_blocks) {
+      context->offset += available;
+      position = size;
+      break;
+    }
+
+    if (!context->header_read) {
+      if (available < 8) break;
+      context->archive_block_size = read_little_endian_32(bytes + 4);
+      if (bytes[0] != 'H' || bytes[1] != 'F' || bytes[2] != FORMAT_BLOCKS ||
+          context->archive_block_size == 0 ||
+          context->archive_block_size > MAX_BLOCK_SIZE) {
+        return HUFFMAN_ERROR_CORRUPT;
+      }
+      if (!reserve_buffer(&job->output, &job->output_capacity,
+                          context->archive_block_size)) {
+        return HUFFMAN_ERROR_MEMORY;
+      }
+      context->flags = bytes[3] & 0x07;
+      context->header_read = true;
+      position += 8;
+      continue;
+    }
+
+    if (available < 4) break;
+    size_t header_size = 4;
+    size_t payload_size = 0;
+    if (read_little_endian_32(bytes) != 0) {
+      if (available <= get_block_type_offset(context->flags)) break;
+      header_size = get_block_header_size(bytes, context->flags);
+      if (available < header_size) break;
+      payload_size = get_block_payload_size(bytes, context->flags);
+    }
+    if (available - header_size < payload_size) break;
+
+    input_t archive = {.data = (unsigned char*)bytes,
+                       .size = available,
+                       .mapped = true};
+    status = read_block_header(&archive, job, context->archive_block_size,
+                               context->flags, &context->end_of_blocks);
+    if (status != HUFFMAN_OK) return status;
+    position += archive.position;
+    if (context->end_of_blocks) continue;
+
+    job->target = job->output;
+    decompress_block_job(job, 0);
+    if (job->status != HUFFMAN_OK) return job->status;
+
+    status = context->write(context->opaque, job->target, job->target_size)
+                 ? HUFFMAN_OK
+                 : HUFFMAN_ERROR_WRITE;
+    context->block_count++;
+  }
+
+  *consumed = position;
+  return status;
+}
+
+huffman_status_t huffman_extract_chunk(huffman_context_t* context,
+                                       const void* data, size_t size) {
+  if (!context || (!data && size > 0)) return HUFFMAN_ERROR_ARGUMENT;
+  if (context->stream != STREAM_EXTRACTING) return HUFFMAN_ERROR_STATE;
+
+  const unsigned char* bytes = data;
+  size_t consumed = 0;
+  bool buffered = context->pending_size > 0;
+  if (!buffered) {
+    huffman_status_t status = parse_archive(context, bytes, size, &consumed);
+    if (status != HUFFMAN_OK) return fail_stream(context, status);
+    bytes += consumed;
+    size -= consumed;
+  }
+  if (size == 0) return HUFFMAN_OK;
+
+  size_t needed = context->pending_size + size;
+  if (needed > context->pending_capacity &&
+      !reserve_buffer(&context->pending, &context->pending_capacity,
+                      needed > 2 * context->pending_capacity
+                          ? needed
+                          : 2 * context->pending_capacity)) {
+    return fail_stream(context, HUFFMAN_ERROR_MEMORY);
+  }
+  memcpy(context->pending + context->pending_size, bytes, size);
+  context->pending_size += size;
+  if (!buffered) return HUFFMAN_OK;
+
+  huffman_status_t status = parse_archive(context, context->pending,
+                                          context->pending_size, &consumed);
+  memmove(context->pending, context->pending + consumed,
+          context->pending_size - consumed);
+  context->pending_size -= consumed;
+  return fail_stream(context, status);
+}
+
+huffman_status_t huffman_finish_extract(huffman_context_t* context) {
+  if (!context) return HUFFMAN_ERROR_ARGUMENT;
+  if (context->stream != STREAM_EXTRACTING) return HUFFMAN_ERROR_STATE;
+
+  context->stream = STREAM_IDLE;
+  uint64_t index_size = 8 * (uint64_t)context->block_count + 16;
+  if (!context->end_of_blocks || context->offset < index_size) {
+    return HUFFMAN_ERROR_TRUNCATED;
+  }
+  return context->offset == index_size ? HUFFMAN_OK : HUFFMAN_ERROR_CORRUPT;
+}
+
+huffman_status_t huffman_extract(huffman_context_t* context, const void* input,
+                                 size_t input_size, void* output,
+                                 size_t output_capacity, size_t* output_size) {
+  if (!output_size || (!output && output_capacity > 0)) {
+    return HUFFMAN_ERROR_ARGUMENT;
+  }
+
+  memory_sink_t sink = {output, 0, output_capacity, false};
+  huffman_status_t status =
+      huffman_begin_extract(context, write_memory_sink, &sink);
+  if (status == HUFFMAN_OK) {
+    status = huffman_extract_chunk(context, input, input_size);
+  }
+  if (status == HUFFMAN_OK) status = huffman_finish_extract(context);
+  if (sink.overflow) status = HUFFMAN_ERROR_BUFFER_TOO_SMALL;
+
+  *output_size = sink.size;
+  return status;
 }
 
-int main() {
+const char* huffman_get_status_message(huffman_status_t status) {
+  switch (status) {
+    case HUFFMAN_OK:
+      return "Success";
+    case HUFFMAN_ERROR_MEMORY:
+      return "Could not allocate memory";
+    case HUFFMAN_ERROR_ARGUMENT:
+      return "Invalid argument";
+    case HUFFMAN_ERROR_STATE:
+      return "Call does not match the stream in progress";
+    case HUFFMAN_ERROR_BUFFER_TOO_SMALL:
+      return "Output buffer is too small";
+    case HUFFMAN_ERROR_CORRUPT:
+      return "Compressed data is corrupted";
+    case HUFFMAN_ERROR_TRUNCATED:
+      return "Compressed data is truncated";
+    case HUFFMAN_ERROR_WRITE:
+      return "Could not write output";
+  }
+  return "Unknown error";
+}
+
+#ifndef HUFFMAN_NO_MAIN
+int main(int argc, char** argv) {
   int mode;
   char* file_name;
   unsigned char* content;
   size_t file_size;
   size_t* frequencies;
-  node_t* head;
-  node_t* root;
-  int tree_height;
-  char** codes;
-  char* current_code;
+  tree_t tree;
+  code_t codes[ASCII_SIZE];
   char* compressed_name;
 
+  if (argc > 1) return run_command_line(argc, argv);
+
   display_menu();
   if (scanf("%d", &mode) != 1) {
     log_error("Invalid input");
@@ -509,40 +4298,48 @@ int main() {
 
   file_name = get_file_name();
 
-  if (mode == 1) {
+  if (mode == 1 || mode == 3) {
     log_info("Starting compression process...");
 
-    content = get_file_content(file_name, &file_size);
+    bool mapped;
+    content = map_file_content(file_name, &file_size, &mapped);
     frequencies = get_frequencies(content, file_size);
-    head = create_list(frequencies);
-    root = create_tree(head);
-    tree_height = get_tree_height(root);
-
-    codes = malloc(ASCII_SIZE * sizeof(char*));
-    if (!codes) {
-      log_error("Could not allocate memory for codes");
+    init_tree(&tree);
+    package_merge_t* scratch = NULL;
+    if (!build_codes(&tree, frequencies, codes, mode == 3,
+                     DEFAULT_MAX_CODE_LENGTH, &scratch)) {
+      log_error("Could not build Huffman codes");
       exit(EXIT_FAILURE);
     }
+    free(scratch);
 
-    for (int i = 0; i < ASCII_SIZE; i++) {
-      codes[i] = calloc(tree_height + 2, sizeof(char));
-      if (!codes[i]) {
-        log_error("Could not allocate memory for code string");
-        for (int j = 0; j < i; j++) free(codes[j]);
-        free(codes);
-        exit(EXIT_FAILURE);
-      }
-    }
-
-    current_code = calloc(tree_height + 2, sizeof(char));
-    if (!current_code) {
-      log_error("Could not allocate memory for code generation");
-      for (int i = 0; i < ASCII_SIZE; i++) free(codes[i]);
-      free(codes);
+    compressed_name = malloc(strlen(file_name) + 10);
+    if (!compressed_name) {
+      log_error("Could not allocate memory for compressed file name");
       exit(EXIT_FAILURE);
     }
+    strcpy(compressed_name, file_name);
+    change_file_extension(compressed_name, ".huff");
+
+    write_compressed_file(compressed_name, content, file_size, codes, &tree,
+                          mode == 3 ? FORMAT_CANONICAL : FORMAT_TREE);
+
+    destroy_tree(&tree);
+    release_file_content(content, file_size, mapped);
+    free(compressed_name);
+    free(file_name);
+    free(frequencies);
+    log_info("Compression completed successfully");
 
-    generate_codes(root, codes, current_code, 0);
+  } else if (mode >= 4 && mode <= 6) {
+    log_info("Starting compression process...");
+
+    FILE* input_file = fopen(file_name, "rb");
+    if (!input_file) {
+      log_error("Could not open input file");
+      free(file_name);
+      return EXIT_FAILURE;
+    }
 
     compressed_name = malloc(strlen(file_name) + 10);
     if (!compressed_name) {
@@ -552,18 +4349,34 @@ int main() {
     strcpy(compressed_name, file_name);
     change_file_extension(compressed_name, ".huff");
 
-    write_compressed_file(compressed_name, content, file_size, codes, root);
+    FILE* output_file = fopen(compressed_name, "wb");
+    if (!output_file) {
+      log_error("Could not open file for writing");
+      exit(EXIT_FAILURE);
+    }
 
-    destroy_tree(root);
-    for (int i = 0; i < ASCII_SIZE; i++) {
-      free(codes[i]);
+    const char* error = NULL;
+    bool valid;
+    if (mode == 5) {
+      valid = compress_blocks(input_file, output_file,
+                              get_default_worker_count(),
+                              DEFAULT_MAX_CODE_LENGTH, BLOCK_SIZE, false,
+                              false, NULL, &error);
+    } else if (mode == 6) {
+      valid = compress_adaptive(input_file, output_file, NULL, &error);
+    } else {
+      valid = compress_stream(input_file, output_file,
+                              DEFAULT_MAX_CODE_LENGTH, NULL, &error);
     }
-    free(codes);
-    free(current_code);
-    free(content);
+
+    fclose(input_file);
+    fclose(output_file);
     free(compressed_name);
     free(file_name);
-    free(frequencies);
+    if (!valid) {
+      log_error(error);
+      return EXIT_FAILURE;
+    }
     log_info("Compression completed successfully");
 
   } else if (mode == 2) {
@@ -579,4 +4392,5 @@ int main() {
   }
 
   return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
+#endif
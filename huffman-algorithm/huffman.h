@@ -0,0 +1,101 @@
+#ifndef HUFFMAN_H
+#define HUFFMAN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Result of every library call.
+ */
+typedef enum {
+  HUFFMAN_OK,
+  HUFFMAN_ERROR_MEMORY,
+  HUFFMAN_ERROR_ARGUMENT,
+  HUFFMAN_ERROR_STATE,
+  HUFFMAN_ERROR_BUFFER_TOO_SMALL,
+  HUFFMAN_ERROR_CORRUPT,
+  HUFFMAN_ERROR_TRUNCATED,
+  HUFFMAN_ERROR_WRITE
+} huffman_status_t;
+
+/**
+ * @brief Reusable compression state. Holds the block buffers, code tables
+ * and decode tables, so calls on the same context do not allocate once it
+ * has warmed up. A context must not be used by two threads at once.
+ */
+typedef struct huffman_context huffman_context_t;
+
+/**
+ * @brief Receives output from the streaming calls.
+ * @return false to abort the call with HUFFMAN_ERROR_WRITE
+ */
+typedef bool (*huffman_write_t)(void* opaque, const void* data, size_t size);
+
+/**
+ * @brief Creates a context producing the parallel block format (-p).
+ * @param block_size Bytes per block, 4 KiB to 1 GiB; 0 selects 1 MiB
+ * @param max_code_length Code length limit, 8 to 64; 0 selects 15
+ * @param context_model Allow order-1 context blocks (--context)
+ * @return The context, or NULL on invalid arguments or missing memory
+ */
+huffman_context_t* huffman_create_context(size_t block_size,
+                                          int max_code_length,
+                                          bool context_model);
+
+void huffman_destroy_context(huffman_context_t* context);
+
+/**
+ * @brief Largest output huffman_compress can produce for size input bytes.
+ */
+size_t huffman_compress_bound(const huffman_context_t* context, size_t size);
+
+/**
+ * @brief Compresses a whole buffer. The output is a complete archive that
+ * the command line can also extract.
+ */
+huffman_status_t huffman_compress(huffman_context_t* context,
+                                  const void* input, size_t input_size,
+                                  void* output, size_t output_capacity,
+                                  size_t* output_size);
+
+/**
+ * @brief Reads the extracted size of a complete archive from its index.
+ */
+huffman_status_t huffman_get_extracted_size(const void* input,
+                                            size_t input_size,
+                                            uint64_t* extracted_size);
+
+/**
+ * @brief Extracts a whole archive into a buffer, verifying block checksums.
+ */
+huffman_status_t huffman_extract(huffman_context_t* context, const void* input,
+                                 size_t input_size, void* output,
+                                 size_t output_capacity, size_t* output_size);
+
+/**
+ * @brief Starts a streaming compression. Input passed to
+ * huffman_compress_chunk is cut into blocks, and each finished block is
+ * handed to write. huffman_finish_compress flushes the last block and the
+ * index.
+ */
+huffman_status_t huffman_begin_compress(huffman_context_t* context,
+                                        huffman_write_t write, void* opaque);
+huffman_status_t huffman_compress_chunk(huffman_context_t* context,
+                                        const void* data, size_t size);
+huffman_status_t huffman_finish_compress(huffman_context_t* context);
+
+/**
+ * @brief Starts a streaming extraction. Archive bytes may be passed to
+ * huffman_extract_chunk in pieces of any size, and each decoded block is
+ * handed to write. huffman_finish_extract reports truncated archives.
+ */
+huffman_status_t huffman_begin_extract(huffman_context_t* context,
+                                       huffman_write_t write, void* opaque);
+huffman_status_t huffman_extract_chunk(huffman_context_t* context,
+                                       const void* data, size_t size);
+huffman_status_t huffman_finish_extract(huffman_context_t* context);
+
+const char* huffman_get_status_message(huffman_status_t status);
+
+#endif
@@ -0,0 +1,105 @@
+#!/bin/sh
+# Usage: ./test.sh
+#
+# Builds huffman.c and runs regression checks on small generated inputs.
+# Prints one line per failed check on standard error and exits non-zero
+# when any check fails.
+#
+# Environment: CC, CFLAGS, HUFFMAN (use a prebuilt binary instead).
+
+set -u
+
+dir=$(cd "$(dirname "$0")" && pwd)
+work=$(mktemp -d "${TMPDIR:-/tmp}/huffman-test.XXXXXX") || exit 1
+trap 'rm -rf "$work"' EXIT INT TERM
+
+if [ -n "${HUFFMAN:-}" ]; then
+  bin=$HUFFMAN
+else
+  bin=$work/huffman
+  ${CC:-cc} ${CFLAGS:--O2} -pthread -o "$bin" "$dir/huffman.c" || exit 1
+fi
+
+failures=0
+fail() {
+  failures=$((failures + 1))
+  echo "test.sh: $*" >&2
+}
+
+# repeat FILE SIZE PATTERN: writes SIZE bytes of the printf PATTERN to FILE.
+repeat() {
+  printf "$3" > "$1"
+  while [ "$(wc -c < "$1")" -lt "$2" ]; do
+    cat "$1" "$1" > "$work/repeat" && mv "$work/repeat" "$1"
+  done
+  head -c "$2" "$1" > "$work/repeat" && mv "$work/repeat" "$1"
+}
+
+# roundtrip NAME OPTIONS...: compresses NAME with OPTIONS and extracts it.
+roundtrip() {
+  name=$1
+  shift
+  if ! "$bin" "$@" -o "$work/packed" "$work/$name" 2> "$work/error" ||
+    ! "$bin" -x -o "$work/unpacked" "$work/packed" 2>> "$work/error" ||
+    ! cmp -s "$work/$name" "$work/unpacked"; then
+    fail "round trip failed for $name ($*): $(head -n 1 "$work/error")"
+  fi
+}
+
+# Every context that occurs gets its own table, leaving the shared one empty.
+repeat "$work/cycle4" 40000 '\000\001\002\003'
+repeat "$work/cycle8" 40000 '\000\001\002\003\004\005\006\007'
+for name in cycle4 cycle8; do
+  for mode in "-p" "-p --context" "-p --interleave" "-c" "-a"; do
+    roundtrip "$name" $mode
+  done
+done
+
+# Incompressible blocks are stored raw behind a header of a few bytes.
+head -c 1048576 /dev/urandom > "$work/random"
+for mode in "-p" "-p --context" "-p --interleave"; do
+  roundtrip random $mode --block-size 4
+  limit=$((1048576 + 256 * 32))
+  size=$(wc -c < "$work/packed")
+  if [ "$size" -gt "$limit" ]; then
+    fail "random ($mode --block-size 4) grew to $size bytes, over $limit"
+  fi
+done
+
+# A damaged archive in a batch is reported by name and the rest still extract.
+repeat "$work/text" 100000 'batch mode keeps going\n'
+for mode in -c -p -a; do
+  "$bin" $mode -o "$work/good$mode.huff" "$work/text" 2> /dev/null
+  head -c 2000 "$work/good$mode.huff" > "$work/bad$mode.huff"
+done
+if "$bin" -x "$work/bad-c.huff" "$work/good-c.huff" "$work/bad-p.huff" \
+  "$work/good-p.huff" "$work/bad-a.huff" "$work/good-a.huff" \
+  2> "$work/error"; then
+  fail "batch with damaged archives exited with status 0"
+fi
+for mode in -c -p -a; do
+  if ! grep -q "bad$mode.huff" "$work/error"; then
+    fail "batch error does not name bad$mode.huff"
+  fi
+  if ! cmp -s "$work/text" "$work/good$mode"; then
+    fail "batch stopped before extracting good$mode.huff"
+  fi
+done
+
+# Dictionaries only apply to -c and -x; -p and -a say why instead of usage.
+"$bin" --train "$work/dict" "$work/text" 2> /dev/null
+if ! "$bin" -c -D "$work/dict" -o "$work/packed" "$work/text" ||
+  ! "$bin" -x -D "$work/dict" -o "$work/unpacked" "$work/packed" ||
+  ! cmp -s "$work/text" "$work/unpacked"; then
+  fail "round trip failed for text (-c -D)"
+fi
+for mode in -p -a; do
+  if "$bin" $mode -D "$work/dict" -o "$work/packed" "$work/text" \
+    2> "$work/error"; then
+    fail "$mode -D was accepted"
+  elif ! grep -q "^Error: -D cannot be used with $mode" "$work/error"; then
+    fail "$mode -D did not explain the error: $(head -n 1 "$work/error")"
+  fi
+done
+
+[ "$failures" -eq 0 ]
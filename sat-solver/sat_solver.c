@@ -1,67 +1,467 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #define TAM_LINHA 256
-#define TAM_LEITURA 5
-#define TAM_INICIAL 0
+#define TAM_INICIAL 1024
+#define TAM_BUFFER_LEITURA (1 << 22)
+#define TAM_MAGICA 6
+#define SEM_PROCESSO 127
+#define TAM_CABECALHO 2
+#define SEM_RAZAO SIZE_MAX
+#define INTERVALO_REINICIO 100
+#define INTERVALO_REDUCAO 2000
+#define LBD_PROTEGIDO 2
+#define DECAIMENTO_ATIVIDADE 0.95
+#define LIMITE_ATIVIDADE 1e100
+#define FATOR_REINICIO 1.1
+#define RUIDO_ATIVIDADE 1e-3
+#define INTERVALO_TERMINO 1024
+#define TAM_TROCA (1 << 16)
+#define TAM_COMPARTILHADA 8
+#define CUBOS_POR_TRABALHADOR 32
+#define CANDIDATOS_LOOKAHEAD 64
+#define CLAUSULA_REMOVIDA -1
+#define CLAUSULA_NA_FILA 1
+#define LIMITE_OCORRENCIAS 16
+#define LIMITE_RESOLVENTE 20
+#define LIMITE_VARIAVEIS ((INT_MAX - 2) / 2)
+#define LIMITE_DICA (1 << 20)
 
 typedef struct {
-  int** clausulas;
-  int* tamanhos;
+  int* dados;
+  size_t tamanho;
+  size_t capacidade;
+} sat_arena_t;
+
+typedef struct {
+  sat_arena_t arena;
   int qtdClausulas;
   int qtdVariaveis;
+  int qtdDeclaradas;
 } sat_cnf_t;
 
-typedef struct sat_no {
-  int indice_variavel;
-  struct sat_no* esquerda;
-  struct sat_no* direita;
-} sat_no_t;
+typedef struct {
+  int arquivo;
+  pid_t filho;
+  const char* programa;
+  unsigned char* buffer;
+  size_t tamanho;
+  size_t posicao;
+  long linha;
+  bool falhou;
+} sat_leitor_t;
+
+typedef struct {
+  size_t clausula;
+  int bloqueador;
+} sat_vigia_t;
+
+typedef struct {
+  sat_vigia_t* itens;
+  int tamanho;
+  int capacidade;
+} sat_lista_vigias_t;
+
+typedef struct {
+  int lbd;
+  size_t clausula;
+} sat_candidata_t;
+
+typedef struct {
+  double decaimento;
+  int intervaloReinicio;
+  bool reinicioLuby;
+  double aleatoriedade;
+  signed char fase;
+} sat_config_t;
+
+typedef struct {
+  atomic_int dados[TAM_TROCA];
+  atomic_size_t reservados;
+  atomic_size_t escritos;
+} sat_troca_t;
+
+typedef struct {
+  const sat_cnf_t* cnf;
+  int qtdTrabalhadores;
+  sat_troca_t* trocas;
+  atomic_bool terminado;
+  atomic_int vencedor;
+  bool satisfeita;
+  bool* valores;
+  sat_arena_t cubos;
+  size_t* inicioCubos;
+  atomic_uint_least64_t* faixas;
+} sat_portfolio_t;
+
+typedef struct {
+  sat_portfolio_t* portfolio;
+  int indice;
+  pthread_t thread;
+} sat_trabalhador_t;
+
+typedef enum {
+  SAT_INTERROMPIDA,
+  SAT_SATISFEITA,
+  SAT_INSATISFEITA,
+  SAT_REFUTADA
+} sat_resultado_t;
+
+typedef struct {
+  int ocorrencias;
+  int var;
+} sat_ocorrencia_t;
+
+typedef struct {
+  size_t* itens;
+  int tamanho;
+  int capacidade;
+} sat_lista_t;
+
+typedef struct {
+  sat_arena_t clausulas;
+  sat_lista_t todas;
+  sat_lista_t* ocorrencias;
+  int qtdVariaveis;
+  signed char* valores;
+  bool* eliminadas;
+  bool* tocadas;
+  int* unitarias;
+  int qtdUnitarias;
+  int propagadas;
+  sat_lista_t fila;
+  sat_lista_t candidatos;
+  long* marcas;
+  long marca;
+  int* resolvente;
+  sat_arena_t reconstrucao;
+  int* originais;
+} sat_pre_t;
+
+typedef struct {
+  sat_arena_t clausulas;
+  sat_lista_vigias_t* vigias;
+  int qtdVariaveis;
+  signed char* valores;
+  signed char* fases;
+  int* niveis;
+  size_t* razoes;
+  int* trilha;
+  int tamTrilha;
+  int propagados;
+  int* inicioNivel;
+  int nivelAtual;
+  double* atividades;
+  double incremento;
+  int* heap;
+  int* posicaoHeap;
+  int tamHeap;
+  bool* marcados;
+  int* vistos;
+  long* niveisVistos;
+  int* aprendida;
+  long conflitos;
+  long aprendidas;
+  long proximaReducao;
+  sat_config_t config;
+  uint64_t aleatorio;
+  sat_portfolio_t* portfolio;
+  int indice;
+  size_t* lidos;
+} sat_solver_t;
+
+const sat_config_t CONFIGURACOES[] = {
+    {DECAIMENTO_ATIVIDADE, INTERVALO_REINICIO, true, 0.0, -1},
+    {0.85, INTERVALO_REINICIO, true, 0.02, -1},
+    {0.99, 300, false, 0.0, 1},
+    {0.90, 50, true, 0.01, 0},
+    {0.95, 512, true, 0.0, 1},
+    {0.80, 100, false, 0.05, 0},
+    {0.97, 200, false, 0.01, -1},
+    {0.92, 30, true, 0.0, 0},
+};
+
+void* alocar(size_t tamanho) {
+  void* memoria = malloc(tamanho);
+  if (memoria == NULL && tamanho > 0) {
+    fprintf(stderr, "Erro: memória insuficiente\n");
+    exit(EXIT_FAILURE);
+  }
+  return memoria;
+}
+
+void* realocar(void* memoria, size_t tamanho) {
+  memoria = realloc(memoria, tamanho);
+  if (memoria == NULL && tamanho > 0) {
+    fprintf(stderr, "Erro: memória insuficiente\n");
+    exit(EXIT_FAILURE);
+  }
+  return memoria;
+}
+
+int* literaisClausula(const sat_arena_t* arena, size_t clausula) {
+  return &arena->dados[clausula + TAM_CABECALHO];
+}
+
+int tamanhoClausula(const sat_arena_t* arena, size_t clausula) {
+  return arena->dados[clausula];
+}
+
+size_t proximaClausula(const sat_arena_t* arena, size_t clausula) {
+  return clausula + TAM_CABECALHO + arena->dados[clausula];
+}
+
+void reservarArena(sat_arena_t* arena, size_t extra) {
+  size_t necessario = arena->tamanho + extra;
+  if (necessario <= arena->capacidade) return;
+
+  while (arena->capacidade < necessario) {
+    arena->capacidade =
+        arena->capacidade > 0 ? 2 * arena->capacidade : TAM_INICIAL;
+  }
+  arena->dados = realocar(arena->dados, arena->capacidade * sizeof(int));
+}
 
-void lerCNF(const char* nomeArquivo, sat_cnf_t* cnf) {
-  FILE* arquivo = fopen(nomeArquivo, "r");
-  if (arquivo == NULL) {
+size_t adicionarClausula(sat_arena_t* arena, const int* literais, int tamanho,
+                         int lbd) {
+  reservarArena(arena, TAM_CABECALHO + tamanho);
+
+  size_t clausula = arena->tamanho;
+  arena->dados[clausula] = tamanho;
+  arena->dados[clausula + 1] = lbd;
+  memcpy(literaisClausula(arena, clausula), literais, tamanho * sizeof(int));
+  arena->tamanho += TAM_CABECALHO + tamanho;
+  return clausula;
+}
+
+bool abrirLeitor(sat_leitor_t* leitor, const char* nomeArquivo) {
+  memset(leitor, 0, sizeof(sat_leitor_t));
+  leitor->filho = -1;
+  leitor->linha = 1;
+
+  int arquivo = open(nomeArquivo, O_RDONLY);
+  if (arquivo < 0) {
     perror("Erro ao abrir o arquivo");
-    return;
+    return false;
+  }
+
+  unsigned char magica[TAM_MAGICA];
+  ssize_t lidos = pread(arquivo, magica, TAM_MAGICA, 0);
+  if (lidos >= 2 && magica[0] == 0x1F && magica[1] == 0x8B) {
+    leitor->programa = "gzip";
+  } else if (lidos == TAM_MAGICA &&
+             memcmp(magica, "\xFD" "7zXZ", TAM_MAGICA) == 0) {
+    leitor->programa = "xz";
   }
 
+  leitor->arquivo = arquivo;
+  if (leitor->programa != NULL) {
+    int canal[2];
+    if (pipe(canal) < 0 || (leitor->filho = fork()) < 0) {
+      perror("Erro ao iniciar o descompressor");
+      close(arquivo);
+      return false;
+    }
+
+    if (leitor->filho == 0) {
+      dup2(arquivo, STDIN_FILENO);
+      dup2(canal[1], STDOUT_FILENO);
+      close(arquivo);
+      close(canal[0]);
+      close(canal[1]);
+      execlp(leitor->programa, leitor->programa, "-dc", (char*)NULL);
+      _exit(SEM_PROCESSO);
+    }
+
+    close(arquivo);
+    close(canal[1]);
+    leitor->arquivo = canal[0];
+  }
+
+  leitor->buffer = alocar(TAM_BUFFER_LEITURA);
+  return true;
+}
+
+int proximoCaractere(sat_leitor_t* leitor) {
+  if (leitor->posicao == leitor->tamanho) {
+    ssize_t lidos;
+    do {
+      lidos = read(leitor->arquivo, leitor->buffer, TAM_BUFFER_LEITURA);
+    } while (lidos < 0 && errno == EINTR);
+
+    if (lidos <= 0) {
+      if (lidos < 0) {
+        perror("Erro ao ler o arquivo");
+        leitor->falhou = true;
+      }
+      return EOF;
+    }
+    leitor->tamanho = (size_t)lidos;
+    leitor->posicao = 0;
+  }
+  return leitor->buffer[leitor->posicao++];
+}
+
+bool fecharLeitor(sat_leitor_t* leitor) {
+  close(leitor->arquivo);
+  free(leitor->buffer);
+  if (leitor->filho <= 0) return !leitor->falhou;
+
+  int estado;
+  while (waitpid(leitor->filho, &estado, 0) < 0 && errno == EINTR) continue;
+  if (WIFEXITED(estado) && WEXITSTATUS(estado) == SEM_PROCESSO) {
+    fprintf(stderr, "Erro: não foi possível executar %s\n", leitor->programa);
+    return false;
+  }
+  if (!WIFEXITED(estado) || WEXITSTATUS(estado) != 0) {
+    fprintf(stderr, "Erro: %s falhou ao descomprimir o arquivo\n",
+            leitor->programa);
+    return false;
+  }
+  return !leitor->falhou;
+}
+
+bool espaco(int caractere) {
+  return caractere == ' ' || caractere == '\t' || caractere == '\r' ||
+         caractere == '\n' || caractere == '\f' || caractere == '\v';
+}
+
+bool erroLeitura(sat_leitor_t* leitor, const char* mensagem) {
+  fprintf(stderr, "Erro na linha %ld: %s\n", leitor->linha, mensagem);
+  return false;
+}
+
+bool lerCabecalho(sat_leitor_t* leitor, sat_cnf_t* cnf) {
   char linha[TAM_LINHA];
-  int clausulaAtual = 0;
+  size_t tamanho = 0;
+  int caractere = 'p';
+  while (caractere != EOF && caractere != '\n') {
+    if (tamanho + 1 < sizeof(linha)) linha[tamanho++] = (char)caractere;
+    caractere = proximoCaractere(leitor);
+  }
+  linha[tamanho] = '\0';
+  leitor->linha++;
+
+  long qtdVariaveis;
+  long qtdClausulas;
+  if (sscanf(linha, "p cnf %ld %ld", &qtdVariaveis, &qtdClausulas) != 2 ||
+      qtdVariaveis < 0 || qtdClausulas < 0 || qtdClausulas > INT_MAX) {
+    return erroLeitura(leitor, "cabeçalho 'p cnf' inválido");
+  }
+  if (qtdVariaveis > LIMITE_VARIAVEIS) {
+    return erroLeitura(leitor, "variáveis demais no cabeçalho");
+  }
 
-  while (fgets(linha, sizeof(linha), arquivo)) {
-    if (linha[0] == 'c') continue;
+  if (qtdVariaveis > cnf->qtdDeclaradas) cnf->qtdDeclaradas = (int)qtdVariaveis;
+  if (qtdClausulas > LIMITE_DICA) qtdClausulas = LIMITE_DICA;
+  reservarArena(&cnf->arena, (size_t)qtdClausulas * (TAM_CABECALHO + 3));
+  return true;
+}
 
-    if (strncmp(linha, "p cnf", TAM_LEITURA) == 0) {
-      sscanf(linha, "p cnf %d %d", &cnf->qtdVariaveis, &cnf->qtdClausulas);
-      cnf->clausulas = malloc(cnf->qtdClausulas * sizeof(int*));
-      cnf->tamanhos = malloc(cnf->qtdClausulas * sizeof(int));
+bool lerClausulas(sat_leitor_t* leitor, sat_cnf_t* cnf) {
+  sat_arena_t* arena = &cnf->arena;
+  size_t clausula = 0;
+  bool aberta = false;
+  int caractere = proximoCaractere(leitor);
+
+  while (caractere != EOF) {
+    if (caractere == '\n') leitor->linha++;
+    if (espaco(caractere)) {
+      caractere = proximoCaractere(leitor);
       continue;
     }
 
-    int literal, tamanho = 0;
-    int* clausula = malloc(TAM_LINHA * sizeof(int));
-    char* token = strtok(linha, " ");
+    if (caractere == 'c' || caractere == '%') {
+      bool fim = caractere == '%';
+      while (caractere != EOF && caractere != '\n') {
+        caractere = proximoCaractere(leitor);
+      }
+      if (fim) {
+        while (caractere != EOF) caractere = proximoCaractere(leitor);
+      }
+      continue;
+    }
 
-    while (token != NULL) {
-      literal = atoi(token);
-      if (literal == 0) break;
-      clausula[tamanho++] = literal;
-      token = strtok(NULL, " ");
+    if (caractere == 'p') {
+      if (!lerCabecalho(leitor, cnf)) return false;
+      caractere = proximoCaractere(leitor);
+      continue;
     }
 
-    cnf->clausulas[clausulaAtual] = malloc(tamanho * sizeof(int));
+    bool negativo = caractere == '-';
+    if (negativo) caractere = proximoCaractere(leitor);
+    if (caractere < '0' || caractere > '9') {
+      return erroLeitura(leitor, "caractere inesperado");
+    }
 
-    memcpy(cnf->clausulas[clausulaAtual], clausula, tamanho * sizeof(int));
+    long valor = 0;
+    while (caractere >= '0' && caractere <= '9') {
+      valor = 10 * valor + (caractere - '0');
+      if (valor > LIMITE_VARIAVEIS) {
+        return erroLeitura(leitor, "literal muito grande");
+      }
+      caractere = proximoCaractere(leitor);
+    }
+    if (caractere != EOF && !espaco(caractere)) {
+      return erroLeitura(leitor, "caractere inesperado");
+    }
 
-    cnf->tamanhos[clausulaAtual] = tamanho;
+    if (!aberta) {
+      reservarArena(arena, TAM_CABECALHO);
+      clausula = arena->tamanho;
+      arena->dados[clausula + 1] = 0;
+      arena->tamanho += TAM_CABECALHO;
+      aberta = true;
+    }
+
+    if (valor == 0) {
+      if (cnf->qtdClausulas == INT_MAX) {
+        return erroLeitura(leitor, "cláusulas demais");
+      }
+      arena->dados[clausula] =
+          (int)(arena->tamanho - clausula - TAM_CABECALHO);
+      cnf->qtdClausulas++;
+      aberta = false;
+      continue;
+    }
 
-    clausulaAtual++;
+    if (valor > cnf->qtdVariaveis) cnf->qtdVariaveis = (int)valor;
+    if (arena->tamanho == arena->capacidade) reservarArena(arena, 1);
+    arena->dados[arena->tamanho++] = negativo ? -(int)valor : (int)valor;
+  }
 
-    free(clausula);
+  if (aberta) {
+    if (cnf->qtdClausulas == INT_MAX) {
+      return erroLeitura(leitor, "cláusulas demais");
+    }
+    arena->dados[clausula] = (int)(arena->tamanho - clausula - TAM_CABECALHO);
+    cnf->qtdClausulas++;
   }
-  fclose(arquivo);
+  return true;
+}
+
+bool lerCNF(const char* nomeArquivo, sat_cnf_t* cnf) {
+  sat_leitor_t leitor;
+  memset(cnf, 0, sizeof(sat_cnf_t));
+  if (!abrirLeitor(&leitor, nomeArquivo)) return false;
+
+  bool valido = lerClausulas(&leitor, cnf);
+  if (!fecharLeitor(&leitor)) valido = false;
+  if (!valido) {
+    free(cnf->arena.dados);
+    memset(cnf, 0, sizeof(sat_cnf_t));
+  }
+  return valido;
 }
 
 bool satisfazClausula(int* clausula, int tamanho, bool* valores) {
@@ -76,72 +476,1443 @@ bool satisfazClausula(int* clausula, int tamanho, bool* valores) {
 }
 
 bool verificaCNF(sat_cnf_t* cnf, bool* valores) {
-  for (int i = 0; i < cnf->qtdClausulas; i++) {
-    if (!satisfazClausula(cnf->clausulas[i], cnf->tamanhos[i], valores))
+  const sat_arena_t* arena = &cnf->arena;
+  for (size_t c = 0; c < arena->tamanho; c = proximaClausula(arena, c)) {
+    if (!satisfazClausula(literaisClausula(arena, c), tamanhoClausula(arena, c),
+                          valores))
       return false;
   }
   return true;
 }
 
-sat_no_t* construirArvore(int nivel, int qtdVariaveis) {
-  if (nivel == qtdVariaveis) return NULL;
+int variavel(int literal) { return abs(literal) - 1; }
 
-  sat_no_t* no = malloc(sizeof(sat_no_t));
+int indiceLiteral(int literal) {
+  return 2 * variavel(literal) + (literal < 0);
+}
 
-  no->indice_variavel = nivel;
-  no->esquerda = construirArvore(nivel + 1, qtdVariaveis);
-  no->direita = construirArvore(nivel + 1, qtdVariaveis);
+int valorLiteral(const sat_solver_t* solver, int literal) {
+  int valor = solver->valores[variavel(literal)];
+  return literal > 0 ? valor : -valor;
+}
 
-  return no;
+void vigiar(sat_solver_t* solver, int literal, size_t clausula,
+            int bloqueador) {
+  sat_lista_vigias_t* lista = &solver->vigias[indiceLiteral(literal)];
+  if (lista->tamanho == lista->capacidade) {
+    lista->capacidade = lista->capacidade > 0 ? 2 * lista->capacidade : 4;
+    lista->itens =
+        realocar(lista->itens, lista->capacidade * sizeof(sat_vigia_t));
+  }
+  lista->itens[lista->tamanho++] = (sat_vigia_t){clausula, bloqueador};
 }
 
-bool avaliarArvore(sat_no_t* raiz, sat_cnf_t* cnf, bool* valores) {
-  if (raiz == NULL) return verificaCNF(cnf, valores);
+void vigiarClausula(sat_solver_t* solver, size_t clausula) {
+  int* literais = literaisClausula(&solver->clausulas, clausula);
+  vigiar(solver, literais[0], clausula, literais[1]);
+  vigiar(solver, literais[1], clausula, literais[0]);
+}
 
-  valores[raiz->indice_variavel] = true;
+void atribuir(sat_solver_t* solver, int literal, size_t razao) {
+  int var = variavel(literal);
+  solver->valores[var] = literal > 0 ? 1 : -1;
+  solver->niveis[var] = solver->nivelAtual;
+  solver->razoes[var] = razao;
+  solver->trilha[solver->tamTrilha++] = literal;
+}
+
+bool adicionarOriginal(sat_solver_t* solver, const int* literais,
+                       int tamanho) {
+  int* clausula = solver->aprendida;
+  int tamanhoLimpo = 0;
+  bool tautologia = false;
+
+  for (int i = 0; i < tamanho; i++) {
+    int var = variavel(literais[i]);
+    if (solver->vistos[var] == -literais[i]) {
+      tautologia = true;
+    } else if (solver->vistos[var] != literais[i]) {
+      solver->vistos[var] = literais[i];
+      clausula[tamanhoLimpo++] = literais[i];
+    }
+  }
+  for (int i = 0; i < tamanho; i++) {
+    solver->vistos[variavel(literais[i])] = 0;
+  }
 
-  if (avaliarArvore(raiz->esquerda, cnf, valores)) return true;
+  if (tautologia) return true;
+  if (tamanhoLimpo == 0) return false;
+  if (tamanhoLimpo == 1) {
+    int valor = valorLiteral(solver, clausula[0]);
+    if (valor == 0) atribuir(solver, clausula[0], SEM_RAZAO);
+    return valor >= 0;
+  }
 
-  valores[raiz->indice_variavel] = false;
+  vigiarClausula(solver, adicionarClausula(&solver->clausulas, clausula,
+                                           tamanhoLimpo, 0));
+  return true;
+}
 
-  if (avaliarArvore(raiz->direita, cnf, valores)) return true;
+bool criarSolver(sat_solver_t* solver, const sat_cnf_t* cnf) {
+  int n = cnf->qtdVariaveis;
+  memset(solver, 0, sizeof(sat_solver_t));
+  solver->qtdVariaveis = n;
+  solver->vigias = calloc(2 * n + 2, sizeof(sat_lista_vigias_t));
+  solver->valores = calloc(n + 1, sizeof(signed char));
+  solver->fases = calloc(n + 1, sizeof(signed char));
+  solver->niveis = calloc(n + 1, sizeof(int));
+  solver->razoes = calloc(n + 1, sizeof(size_t));
+  solver->trilha = calloc(n + 1, sizeof(int));
+  solver->inicioNivel = calloc(n + 1, sizeof(int));
+  solver->atividades = calloc(n + 1, sizeof(double));
+  solver->marcados = calloc(n + 1, sizeof(bool));
+  solver->vistos = calloc(n + 1, sizeof(int));
+  solver->niveisVistos = calloc(n + 1, sizeof(long));
+  solver->aprendida = calloc(n + 1, sizeof(int));
+  solver->heap = calloc(n + 1, sizeof(int));
+  solver->posicaoHeap = calloc(n + 1, sizeof(int));
+  if (!solver->vigias || !solver->valores || !solver->fases ||
+      !solver->niveis || !solver->razoes || !solver->trilha ||
+      !solver->inicioNivel || !solver->atividades || !solver->marcados ||
+      !solver->vistos || !solver->niveisVistos || !solver->aprendida ||
+      !solver->heap || !solver->posicaoHeap) {
+    fprintf(stderr, "Erro: memória insuficiente\n");
+    exit(EXIT_FAILURE);
+  }
+  for (int var = 0; var < n; var++) {
+    solver->heap[var] = var;
+    solver->posicaoHeap[var] = var;
+  }
+  solver->tamHeap = n;
+  solver->incremento = 1.0;
+  solver->proximaReducao = INTERVALO_REDUCAO;
 
+  const sat_arena_t* arena = &cnf->arena;
+  bool consistente = true;
+  for (size_t c = 0; c < arena->tamanho && consistente;
+       c = proximaClausula(arena, c)) {
+    consistente = adicionarOriginal(solver, literaisClausula(arena, c),
+                                    tamanhoClausula(arena, c));
+  }
+  return consistente;
+}
+
+void liberarSolver(sat_solver_t* solver) {
+  for (int i = 0; i < 2 * solver->qtdVariaveis + 2; i++) {
+    free(solver->vigias[i].itens);
+  }
+  free(solver->vigias);
+  free(solver->clausulas.dados);
+  free(solver->valores);
+  free(solver->fases);
+  free(solver->niveis);
+  free(solver->razoes);
+  free(solver->trilha);
+  free(solver->inicioNivel);
+  free(solver->atividades);
+  free(solver->marcados);
+  free(solver->vistos);
+  free(solver->niveisVistos);
+  free(solver->aprendida);
+  free(solver->heap);
+  free(solver->posicaoHeap);
+  free(solver->lidos);
+}
+
+uint64_t sortear(sat_solver_t* solver) {
+  solver->aleatorio ^= solver->aleatorio >> 12;
+  solver->aleatorio ^= solver->aleatorio << 25;
+  solver->aleatorio ^= solver->aleatorio >> 27;
+  return solver->aleatorio * 0x2545F4914F6CDD1DULL;
+}
+
+double sortearFracao(sat_solver_t* solver) {
+  return (sortear(solver) >> 11) * 0x1.0p-53;
+}
+
+void trocarHeap(sat_solver_t* solver, int i, int j) {
+  int var = solver->heap[i];
+  solver->heap[i] = solver->heap[j];
+  solver->heap[j] = var;
+  solver->posicaoHeap[solver->heap[i]] = i;
+  solver->posicaoHeap[solver->heap[j]] = j;
+}
+
+void subirHeap(sat_solver_t* solver, int i) {
+  const double* atividades = solver->atividades;
+  while (i > 0) {
+    int pai = (i - 1) / 2;
+    if (atividades[solver->heap[pai]] >= atividades[solver->heap[i]]) return;
+    trocarHeap(solver, i, pai);
+    i = pai;
+  }
+}
+
+void descerHeap(sat_solver_t* solver, int i) {
+  const double* atividades = solver->atividades;
+  while (true) {
+    int maior = i;
+    int esquerdo = 2 * i + 1, direito = 2 * i + 2;
+    if (esquerdo < solver->tamHeap &&
+        atividades[solver->heap[esquerdo]] > atividades[solver->heap[maior]]) {
+      maior = esquerdo;
+    }
+    if (direito < solver->tamHeap &&
+        atividades[solver->heap[direito]] > atividades[solver->heap[maior]]) {
+      maior = direito;
+    }
+    if (maior == i) return;
+    trocarHeap(solver, i, maior);
+    i = maior;
+  }
+}
+
+void inserirHeap(sat_solver_t* solver, int var) {
+  if (solver->posicaoHeap[var] >= 0) return;
+  solver->heap[solver->tamHeap] = var;
+  solver->posicaoHeap[var] = solver->tamHeap;
+  subirHeap(solver, solver->tamHeap++);
+}
+
+int removerHeap(sat_solver_t* solver) {
+  int var = solver->heap[0];
+  solver->posicaoHeap[var] = -1;
+  if (--solver->tamHeap > 0) {
+    solver->heap[0] = solver->heap[solver->tamHeap];
+    solver->posicaoHeap[solver->heap[0]] = 0;
+    descerHeap(solver, 0);
+  }
+  return var;
+}
+
+void configurarSolver(sat_solver_t* solver, sat_portfolio_t* portfolio,
+                      int indice) {
+  int qtdConfiguracoes = sizeof(CONFIGURACOES) / sizeof(CONFIGURACOES[0]);
+  solver->config = CONFIGURACOES[indice % qtdConfiguracoes];
+  solver->aleatorio = 0x9E3779B97F4A7C15ULL * (indice + 1);
+  solver->portfolio = portfolio;
+  solver->indice = indice;
+  solver->lidos = calloc(portfolio->qtdTrabalhadores, sizeof(size_t));
+  if (!solver->lidos) {
+    fprintf(stderr, "Erro: memória insuficiente\n");
+    exit(EXIT_FAILURE);
+  }
+
+  for (int var = 0; var < solver->qtdVariaveis; var++) {
+    if (solver->valores[var] != 0) continue;
+    signed char fase = solver->config.fase;
+    if (fase == 0) fase = sortear(solver) & 1 ? 1 : -1;
+    solver->fases[var] = fase;
+    if (indice > 0) {
+      solver->atividades[var] = RUIDO_ATIVIDADE * sortearFracao(solver);
+    }
+  }
+  for (int i = solver->tamHeap / 2 - 1; i >= 0; i--) descerHeap(solver, i);
+}
+
+void escreverTroca(sat_troca_t* troca, size_t posicao, int valor) {
+  atomic_store_explicit(&troca->dados[posicao % TAM_TROCA], valor,
+                        memory_order_relaxed);
+}
+
+int lerTroca(sat_troca_t* troca, size_t posicao) {
+  return atomic_load_explicit(&troca->dados[posicao % TAM_TROCA],
+                             memory_order_relaxed);
+}
+
+void exportarClausula(sat_solver_t* solver, const int* literais, int tamanho,
+                      int lbd) {
+  sat_portfolio_t* portfolio = solver->portfolio;
+  if (portfolio->qtdTrabalhadores < 2 || tamanho > TAM_COMPARTILHADA) return;
+
+  sat_troca_t* troca = &portfolio->trocas[solver->indice];
+  size_t inicio = atomic_load_explicit(&troca->escritos, memory_order_relaxed);
+  size_t fim = inicio + TAM_CABECALHO + tamanho;
+  atomic_store_explicit(&troca->reservados, fim, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+
+  escreverTroca(troca, inicio, tamanho);
+  escreverTroca(troca, inicio + 1, lbd);
+  for (int i = 0; i < tamanho; i++) {
+    escreverTroca(troca, inicio + TAM_CABECALHO + i, literais[i]);
+  }
+  atomic_store_explicit(&troca->escritos, fim, memory_order_release);
+}
+
+bool importarClausula(sat_solver_t* solver, const int* literais, int tamanho,
+                      int lbd) {
+  int clausula[TAM_COMPARTILHADA];
+  int livres = 0;
+  for (int i = 0; i < tamanho; i++) {
+    int valor = valorLiteral(solver, literais[i]);
+    if (valor > 0) return true;
+    if (valor == 0) clausula[livres++] = literais[i];
+  }
+
+  if (livres == 0) return false;
+  if (livres == 1) {
+    atribuir(solver, clausula[0], SEM_RAZAO);
+    return true;
+  }
+
+  vigiarClausula(solver,
+                 adicionarClausula(&solver->clausulas, clausula, livres, lbd));
+  solver->aprendidas++;
+  return true;
+}
+
+bool importarClausulas(sat_solver_t* solver) {
+  sat_portfolio_t* portfolio = solver->portfolio;
+  for (int i = 0; i < portfolio->qtdTrabalhadores; i++) {
+    if (i == solver->indice) continue;
+
+    sat_troca_t* troca = &portfolio->trocas[i];
+    size_t fim = atomic_load_explicit(&troca->escritos, memory_order_acquire);
+    size_t lido = solver->lidos[i];
+    if (fim - lido > TAM_TROCA) lido = fim;
+
+    while (lido < fim) {
+      int literais[TAM_COMPARTILHADA];
+      int tamanho = lerTroca(troca, lido);
+      int lbd = lerTroca(troca, lido + 1);
+      if (tamanho < 1 || tamanho > TAM_COMPARTILHADA) tamanho = 0;
+      for (int k = 0; k < tamanho; k++) {
+        literais[k] = lerTroca(troca, lido + TAM_CABECALHO + k);
+      }
+
+      atomic_thread_fence(memory_order_acquire);
+      size_t reservados =
+          atomic_load_explicit(&troca->reservados, memory_order_relaxed);
+      if (reservados - lido > TAM_TROCA) {
+        lido = fim;
+        break;
+      }
+
+      lido += TAM_CABECALHO + tamanho;
+      if (!importarClausula(solver, literais, tamanho, lbd)) return false;
+    }
+    solver->lidos[i] = lido;
+  }
+  return true;
+}
+
+void retroceder(sat_solver_t* solver, int nivel) {
+  if (solver->nivelAtual <= nivel) return;
+
+  for (int i = solver->tamTrilha - 1; i >= solver->inicioNivel[nivel]; i--) {
+    int var = variavel(solver->trilha[i]);
+    solver->fases[var] = solver->valores[var];
+    solver->valores[var] = 0;
+    inserirHeap(solver, var);
+  }
+  solver->tamTrilha = solver->inicioNivel[nivel];
+  solver->propagados = solver->tamTrilha;
+  solver->nivelAtual = nivel;
+}
+
+size_t propagar(sat_solver_t* solver) {
+  while (solver->propagados < solver->tamTrilha) {
+    int falso = -solver->trilha[solver->propagados++];
+    sat_lista_vigias_t* lista = &solver->vigias[indiceLiteral(falso)];
+    sat_vigia_t* itens = lista->itens;
+    int mantidos = 0;
+
+    for (int i = 0; i < lista->tamanho; i++) {
+      sat_vigia_t vigia = itens[i];
+      if (valorLiteral(solver, vigia.bloqueador) > 0) {
+        itens[mantidos++] = vigia;
+        continue;
+      }
+
+      int* literais = literaisClausula(&solver->clausulas, vigia.clausula);
+      if (literais[0] == falso) {
+        literais[0] = literais[1];
+        literais[1] = falso;
+      }
+
+      int primeiro = literais[0];
+      vigia.bloqueador = primeiro;
+      if (valorLiteral(solver, primeiro) > 0) {
+        itens[mantidos++] = vigia;
+        continue;
+      }
+
+      int tamanho = tamanhoClausula(&solver->clausulas, vigia.clausula);
+      bool movido = false;
+      for (int k = 2; k < tamanho && !movido; k++) {
+        if (valorLiteral(solver, literais[k]) >= 0) {
+          literais[1] = literais[k];
+          literais[k] = falso;
+          vigiar(solver, literais[1], vigia.clausula, primeiro);
+          movido = true;
+        }
+      }
+      if (movido) continue;
+
+      itens[mantidos++] = vigia;
+      if (valorLiteral(solver, primeiro) < 0) {
+        while (++i < lista->tamanho) itens[mantidos++] = itens[i];
+        lista->tamanho = mantidos;
+        solver->propagados = solver->tamTrilha;
+        return vigia.clausula;
+      }
+      atribuir(solver, primeiro, vigia.clausula);
+    }
+    lista->tamanho = mantidos;
+  }
+  return SEM_RAZAO;
+}
+
+void aumentarAtividade(sat_solver_t* solver, int var) {
+  solver->atividades[var] += solver->incremento;
+  if (solver->posicaoHeap[var] >= 0) {
+    subirHeap(solver, solver->posicaoHeap[var]);
+  }
+  if (solver->atividades[var] < LIMITE_ATIVIDADE) return;
+
+  for (int i = 0; i < solver->qtdVariaveis; i++) {
+    solver->atividades[i] /= LIMITE_ATIVIDADE;
+  }
+  solver->incremento /= LIMITE_ATIVIDADE;
+}
+
+int analisarConflito(sat_solver_t* solver, size_t conflito, int* tamanho,
+                     int* nivelRetorno) {
+  int pendentes = 0;
+  int literal = 0;
+  int posicao = solver->tamTrilha - 1;
+  *tamanho = 1;
+
+  do {
+    int* clausula = literaisClausula(&solver->clausulas, conflito);
+    int tamanhoConflito = tamanhoClausula(&solver->clausulas, conflito);
+    for (int i = 0; i < tamanhoConflito; i++) {
+      int var = variavel(clausula[i]);
+      if (clausula[i] == literal || solver->marcados[var] ||
+          solver->niveis[var] == 0) {
+        continue;
+      }
+
+      solver->marcados[var] = true;
+      aumentarAtividade(solver, var);
+      if (solver->niveis[var] == solver->nivelAtual) {
+        pendentes++;
+      } else {
+        solver->aprendida[(*tamanho)++] = clausula[i];
+      }
+    }
+
+    while (!solver->marcados[variavel(solver->trilha[posicao])]) posicao--;
+    literal = solver->trilha[posicao--];
+    conflito = solver->razoes[variavel(literal)];
+    solver->marcados[variavel(literal)] = false;
+    pendentes--;
+  } while (pendentes > 0);
+
+  solver->aprendida[0] = -literal;
+
+  int maior = 1;
+  int lbd = 1;
+  *nivelRetorno = 0;
+  for (int i = 1; i < *tamanho; i++) {
+    int var = variavel(solver->aprendida[i]);
+    solver->marcados[var] = false;
+    if (solver->niveisVistos[solver->niveis[var]] != solver->conflitos) {
+      solver->niveisVistos[solver->niveis[var]] = solver->conflitos;
+      lbd++;
+    }
+    if (solver->niveis[var] > *nivelRetorno) {
+      *nivelRetorno = solver->niveis[var];
+      maior = i;
+    }
+  }
+
+  int literalRetorno = solver->aprendida[maior];
+  solver->aprendida[maior] = solver->aprendida[1];
+  solver->aprendida[1] = literalRetorno;
+  return lbd;
+}
+
+void aprender(sat_solver_t* solver, int tamanho, int lbd) {
+  int literal = solver->aprendida[0];
+  exportarClausula(solver, solver->aprendida, tamanho, lbd);
+  if (tamanho == 1) {
+    atribuir(solver, literal, SEM_RAZAO);
+    return;
+  }
+
+  size_t clausula =
+      adicionarClausula(&solver->clausulas, solver->aprendida, tamanho, lbd);
+  vigiarClausula(solver, clausula);
+  atribuir(solver, literal, clausula);
+  solver->aprendidas++;
+}
+
+int compararCandidatas(const void* primeira, const void* segunda) {
+  const sat_candidata_t* a = primeira;
+  const sat_candidata_t* b = segunda;
+  if (a->lbd != b->lbd) return b->lbd - a->lbd;
+  return (a->clausula > b->clausula) - (a->clausula < b->clausula);
+}
+
+void reduzirClausulas(sat_solver_t* solver) {
+  sat_arena_t* arena = &solver->clausulas;
+  sat_candidata_t* candidatas =
+      alocar((solver->aprendidas + 1) * sizeof(sat_candidata_t));
+  long qtdCandidatas = 0;
+  for (size_t c = 0; c < arena->tamanho; c = proximaClausula(arena, c)) {
+    if (arena->dados[c + 1] > LBD_PROTEGIDO) {
+      candidatas[qtdCandidatas++] = (sat_candidata_t){arena->dados[c + 1], c};
+    }
+  }
+  qsort(candidatas, qtdCandidatas, sizeof(sat_candidata_t),
+        compararCandidatas);
+  for (long i = 0; i < qtdCandidatas / 2; i++) {
+    arena->dados[candidatas[i].clausula + 1] = -1;
+  }
+  free(candidatas);
+
+  for (int i = 0; i < 2 * solver->qtdVariaveis + 2; i++) {
+    solver->vigias[i].tamanho = 0;
+  }
+
+  size_t destino = 0;
+  solver->aprendidas = 0;
+  for (size_t c = 0; c < arena->tamanho;) {
+    size_t proxima = proximaClausula(arena, c);
+    int lbd = arena->dados[c + 1];
+    int* literais = literaisClausula(arena, c);
+    int tamanho = 0;
+    bool removida = lbd < 0;
+
+    for (int i = 0; i < tamanhoClausula(arena, c) && !removida; i++) {
+      int valor = valorLiteral(solver, literais[i]);
+      if (valor > 0) removida = true;
+      if (valor == 0) literais[tamanho++] = literais[i];
+    }
+
+    if (!removida) {
+      memmove(literaisClausula(arena, destino), literais,
+              tamanho * sizeof(int));
+      arena->dados[destino] = tamanho;
+      arena->dados[destino + 1] = lbd;
+      vigiarClausula(solver, destino);
+      if (lbd > 0) solver->aprendidas++;
+      destino += TAM_CABECALHO + tamanho;
+    }
+    c = proxima;
+  }
+  arena->tamanho = destino;
+
+  for (int i = 0; i < solver->tamTrilha; i++) {
+    solver->razoes[variavel(solver->trilha[i])] = SEM_RAZAO;
+  }
+}
+
+int literalDecisao(const sat_solver_t* solver, int var) {
+  return solver->fases[var] > 0 ? var + 1 : -(var + 1);
+}
+
+int escolherLiteral(sat_solver_t* solver) {
+  if (solver->qtdVariaveis > 0 && solver->config.aleatoriedade > 0 &&
+      sortearFracao(solver) < solver->config.aleatoriedade) {
+    int var = sortear(solver) % solver->qtdVariaveis;
+    if (solver->valores[var] == 0) return literalDecisao(solver, var);
+  }
+
+  while (solver->tamHeap > 0) {
+    int var = removerHeap(solver);
+    if (solver->valores[var] == 0) return literalDecisao(solver, var);
+  }
+  return 0;
+}
+
+long luby(long indice) {
+  long tamanho = 1, potencia = 1;
+  while (tamanho < indice + 1) {
+    potencia *= 2;
+    tamanho = 2 * tamanho + 1;
+  }
+
+  while (tamanho - 1 != indice) {
+    tamanho = (tamanho - 1) / 2;
+    potencia /= 2;
+    indice %= tamanho;
+  }
+  return potencia;
+}
+
+long proximoReinicio(const sat_config_t* config, long reinicios,
+                     double* interno, double* externo) {
+  if (config->reinicioLuby) return config->intervaloReinicio * luby(reinicios);
+
+  *interno *= FATOR_REINICIO;
+  if (*interno > *externo) {
+    *externo *= FATOR_REINICIO;
+    *interno = config->intervaloReinicio;
+  }
+  return (long)*interno;
+}
+
+sat_resultado_t buscar(sat_solver_t* solver, const int* suposicoes,
+                       int qtdSuposicoes) {
+  long reinicios = 0;
+  double interno = solver->config.intervaloReinicio;
+  double externo = interno;
+  long limiteReinicio = solver->config.intervaloReinicio;
+  long conflitosReinicio = 0;
+  long decisoes = 0;
+
+  while (true) {
+    size_t conflito = propagar(solver);
+    if (conflito != SEM_RAZAO) {
+      solver->conflitos++;
+      conflitosReinicio++;
+      if (solver->nivelAtual == 0) return SAT_INSATISFEITA;
+      if (atomic_load_explicit(&solver->portfolio->terminado,
+                               memory_order_relaxed)) {
+        return SAT_INTERROMPIDA;
+      }
+
+      int tamanho, nivel;
+      int lbd = analisarConflito(solver, conflito, &tamanho, &nivel);
+      retroceder(solver, nivel);
+      aprender(solver, tamanho, lbd);
+      solver->incremento /= solver->config.decaimento;
+      continue;
+    }
+
+    if (conflitosReinicio >= limiteReinicio) {
+      retroceder(solver, 0);
+      reinicios++;
+      limiteReinicio =
+          proximoReinicio(&solver->config, reinicios, &interno, &externo);
+      conflitosReinicio = 0;
+
+      if (solver->conflitos >= solver->proximaReducao) {
+        reduzirClausulas(solver);
+        solver->proximaReducao = solver->conflitos + INTERVALO_REDUCAO;
+      }
+      if (!importarClausulas(solver)) return SAT_INSATISFEITA;
+      continue;
+    }
+
+    int literal = 0;
+    while (literal == 0 && solver->nivelAtual < qtdSuposicoes) {
+      int suposicao = suposicoes[solver->nivelAtual];
+      int valor = valorLiteral(solver, suposicao);
+      if (valor < 0) return SAT_REFUTADA;
+      if (valor > 0) {
+        solver->inicioNivel[solver->nivelAtual++] = solver->tamTrilha;
+      } else {
+        literal = suposicao;
+      }
+    }
+    if (literal == 0) literal = escolherLiteral(solver);
+    if (literal == 0) return SAT_SATISFEITA;
+    if (++decisoes % INTERVALO_TERMINO == 0 &&
+        atomic_load_explicit(&solver->portfolio->terminado,
+                             memory_order_relaxed)) {
+      return SAT_INTERROMPIDA;
+    }
+
+    solver->inicioNivel[solver->nivelAtual++] = solver->tamTrilha;
+    atribuir(solver, literal, SEM_RAZAO);
+  }
+}
+
+void anunciarResultado(sat_portfolio_t* portfolio, const sat_solver_t* solver,
+                       int indice, sat_resultado_t resultado) {
+  int esperado = -1;
+  if (resultado == SAT_INTERROMPIDA || resultado == SAT_REFUTADA ||
+      !atomic_compare_exchange_strong(&portfolio->vencedor, &esperado,
+                                      indice)) {
+    return;
+  }
+
+  portfolio->satisfeita = resultado == SAT_SATISFEITA;
+  for (int var = 0; var < portfolio->cnf->qtdVariaveis &&
+                    portfolio->satisfeita;
+       var++) {
+    portfolio->valores[var] = solver->valores[var] > 0;
+  }
+  atomic_store(&portfolio->terminado, true);
+}
+
+void* trabalhar(void* argumento) {
+  sat_trabalhador_t* trabalhador = argumento;
+  sat_portfolio_t* portfolio = trabalhador->portfolio;
+  sat_solver_t solver;
+  sat_resultado_t resultado = SAT_INSATISFEITA;
+
+  if (criarSolver(&solver, portfolio->cnf)) {
+    configurarSolver(&solver, portfolio, trabalhador->indice);
+    resultado = buscar(&solver, NULL, 0);
+  }
+
+  anunciarResultado(portfolio, &solver, trabalhador->indice, resultado);
+  liberarSolver(&solver);
+  return NULL;
+}
+
+int compararOcorrencias(const void* primeira, const void* segunda) {
+  const sat_ocorrencia_t* a = primeira;
+  const sat_ocorrencia_t* b = segunda;
+  if (a->ocorrencias != b->ocorrencias) return b->ocorrencias - a->ocorrencias;
+  return a->var - b->var;
+}
+
+int testarLiteral(sat_solver_t* solver, int literal) {
+  int inicio = solver->tamTrilha;
+  solver->inicioNivel[solver->nivelAtual++] = inicio;
+  atribuir(solver, literal, SEM_RAZAO);
+  bool conflito = propagar(solver) != SEM_RAZAO;
+  int implicados = solver->tamTrilha - inicio;
+  retroceder(solver, solver->nivelAtual - 1);
+  return conflito ? -1 : implicados;
+}
+
+void dividir(sat_solver_t* solver, const sat_ocorrencia_t* ordem,
+             int profundidade, sat_arena_t* cubos) {
+  int nivelEntrada = solver->nivelAtual;
+  int primeiro = 0;
+  while (true) {
+    while (primeiro < solver->qtdVariaveis &&
+           solver->valores[ordem[primeiro].var] != 0) {
+      primeiro++;
+    }
+
+    int melhor = 0;
+    long melhorPontuacao = -1;
+    bool forcado = false;
+    for (int i = primeiro, testados = 0;
+         i < solver->qtdVariaveis && testados < CANDIDATOS_LOOKAHEAD &&
+         profundidade > 0;
+         i++) {
+      int literal = ordem[i].var + 1;
+      if (solver->valores[ordem[i].var] != 0) continue;
+      testados++;
+
+      int positivos = testarLiteral(solver, literal);
+      int negativos = testarLiteral(solver, -literal);
+      if (positivos < 0 && negativos < 0) {
+        retroceder(solver, nivelEntrada);
+        return;
+      }
+      if (positivos < 0 || negativos < 0) {
+        melhor = positivos < 0 ? -literal : literal;
+        forcado = true;
+        break;
+      }
+
+      long pontuacao = (long)positivos * negativos + positivos + negativos;
+      if (pontuacao > melhorPontuacao) {
+        melhorPontuacao = pontuacao;
+        melhor = literal;
+      }
+    }
+
+    if (melhor == 0) {
+      for (int nivel = 0; nivel < solver->nivelAtual; nivel++) {
+        solver->aprendida[nivel] = solver->trilha[solver->inicioNivel[nivel]];
+      }
+      adicionarClausula(cubos, solver->aprendida, solver->nivelAtual, 0);
+      break;
+    }
+
+    int nivel = solver->nivelAtual;
+    if (forcado) {
+      solver->inicioNivel[solver->nivelAtual++] = solver->tamTrilha;
+      atribuir(solver, melhor, SEM_RAZAO);
+      if (propagar(solver) == SEM_RAZAO) continue;
+      break;
+    }
+
+    int ramos[] = {melhor, -melhor};
+    for (int i = 0; i < 2; i++) {
+      solver->inicioNivel[solver->nivelAtual++] = solver->tamTrilha;
+      atribuir(solver, ramos[i], SEM_RAZAO);
+      if (propagar(solver) == SEM_RAZAO) {
+        dividir(solver, ordem, profundidade - 1, cubos);
+      }
+      retroceder(solver, nivel);
+    }
+    break;
+  }
+  retroceder(solver, nivelEntrada);
+}
+
+void gerarCubos(sat_portfolio_t* portfolio) {
+  const sat_cnf_t* cnf = portfolio->cnf;
+  int qtdTrabalhadores = portfolio->qtdTrabalhadores;
+  long qtdDesejada = (long)CUBOS_POR_TRABALHADOR * qtdTrabalhadores;
+  int profundidade = 0;
+  while ((1L << profundidade) < qtdDesejada) profundidade++;
+
+  sat_solver_t solver;
+  if (criarSolver(&solver, cnf) && propagar(&solver) == SEM_RAZAO) {
+    sat_ocorrencia_t* ordem =
+        alocar((cnf->qtdVariaveis + 1) * sizeof(sat_ocorrencia_t));
+    for (int var = 0; var < cnf->qtdVariaveis; var++) {
+      ordem[var] = (sat_ocorrencia_t){0, var};
+    }
+    const sat_arena_t* arena = &cnf->arena;
+    for (size_t c = 0; c < arena->tamanho; c = proximaClausula(arena, c)) {
+      int* literais = literaisClausula(arena, c);
+      for (int i = 0; i < tamanhoClausula(arena, c); i++) {
+        ordem[variavel(literais[i])].ocorrencias++;
+      }
+    }
+    qsort(ordem, cnf->qtdVariaveis, sizeof(sat_ocorrencia_t),
+          compararOcorrencias);
+
+    dividir(&solver, ordem, profundidade, &portfolio->cubos);
+    free(ordem);
+  }
+  liberarSolver(&solver);
+
+  const sat_arena_t* cubos = &portfolio->cubos;
+  int qtdCubos = 0;
+  for (size_t c = 0; c < cubos->tamanho; c = proximaClausula(cubos, c)) {
+    qtdCubos++;
+  }
+  portfolio->inicioCubos = alocar((qtdCubos + 1) * sizeof(size_t));
+  portfolio->faixas = alocar(qtdTrabalhadores * sizeof(atomic_uint_least64_t));
+  qtdCubos = 0;
+  for (size_t c = 0; c < cubos->tamanho; c = proximaClausula(cubos, c)) {
+    portfolio->inicioCubos[qtdCubos++] = c;
+  }
+
+  for (int i = 0; i < qtdTrabalhadores; i++) {
+    uint64_t inicio = (uint64_t)qtdCubos * i / qtdTrabalhadores;
+    uint64_t fim = (uint64_t)qtdCubos * (i + 1) / qtdTrabalhadores;
+    atomic_init(&portfolio->faixas[i], inicio << 32 | fim);
+  }
+}
+
+bool proximoCubo(sat_portfolio_t* portfolio, int indice, size_t* cubo) {
+  for (int k = 0; k < portfolio->qtdTrabalhadores; k++) {
+    if (atomic_load_explicit(&portfolio->terminado, memory_order_relaxed)) {
+      return false;
+    }
+
+    atomic_uint_least64_t* faixa =
+        &portfolio->faixas[(indice + k) % portfolio->qtdTrabalhadores];
+    uint64_t atual = atomic_load(faixa);
+    while ((atual >> 32) < (atual & UINT32_MAX)) {
+      bool proprio = k == 0;
+      uint64_t nova = proprio ? atual - 1 : atual + ((uint64_t)1 << 32);
+      if (atomic_compare_exchange_weak(faixa, &atual, nova)) {
+        size_t posicao = proprio ? (atual & UINT32_MAX) - 1 : atual >> 32;
+        *cubo = portfolio->inicioCubos[posicao];
+        return true;
+      }
+    }
+  }
   return false;
 }
 
-void liberarArvore(sat_no_t* raiz) {
-  if (raiz == NULL) return;
+void* conquistar(void* argumento) {
+  sat_trabalhador_t* trabalhador = argumento;
+  sat_portfolio_t* portfolio = trabalhador->portfolio;
+  sat_solver_t solver;
+  sat_resultado_t resultado = SAT_INSATISFEITA;
+
+  if (criarSolver(&solver, portfolio->cnf)) {
+    configurarSolver(&solver, portfolio, trabalhador->indice);
+    resultado = SAT_REFUTADA;
+    size_t cubo;
+    while (resultado == SAT_REFUTADA &&
+           proximoCubo(portfolio, trabalhador->indice, &cubo)) {
+      retroceder(&solver, 0);
+      resultado = buscar(&solver, literaisClausula(&portfolio->cubos, cubo),
+                         tamanhoClausula(&portfolio->cubos, cubo));
+    }
+  }
+
+  anunciarResultado(portfolio, &solver, trabalhador->indice, resultado);
+  liberarSolver(&solver);
+  return NULL;
+}
+
+bool resolverCNF(const sat_cnf_t* cnf, bool* valores, int qtdTrabalhadores,
+                 bool cuboConquista) {
+  sat_portfolio_t portfolio = {.cnf = cnf,
+                               .qtdTrabalhadores = qtdTrabalhadores,
+                               .valores = valores};
+  atomic_init(&portfolio.terminado, false);
+  atomic_init(&portfolio.vencedor, -1);
+  portfolio.trocas = calloc(qtdTrabalhadores, sizeof(sat_troca_t));
+  sat_trabalhador_t* trabalhadores =
+      calloc(qtdTrabalhadores, sizeof(sat_trabalhador_t));
+  if (!portfolio.trocas || !trabalhadores) {
+    fprintf(stderr, "Erro: memória insuficiente\n");
+    exit(EXIT_FAILURE);
+  }
+
+  void* (*funcao)(void*) = trabalhar;
+  if (cuboConquista) {
+    gerarCubos(&portfolio);
+    funcao = conquistar;
+  }
+
+  for (int i = 0; i < qtdTrabalhadores; i++) {
+    trabalhadores[i] = (sat_trabalhador_t){&portfolio, i, 0};
+  }
+  for (int i = 1; i < qtdTrabalhadores; i++) {
+    if (pthread_create(&trabalhadores[i].thread, NULL, funcao,
+                       &trabalhadores[i]) != 0) {
+      fprintf(stderr, "Erro: não foi possível criar as threads\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  funcao(&trabalhadores[0]);
+  for (int i = 1; i < qtdTrabalhadores; i++) {
+    pthread_join(trabalhadores[i].thread, NULL);
+  }
+
+  free(trabalhadores);
+  free(portfolio.trocas);
+  free(portfolio.cubos.dados);
+  free(portfolio.inicioCubos);
+  free(portfolio.faixas);
+  return portfolio.satisfeita;
+}
+
+int qtdNucleos() {
+  long quantidade = sysconf(_SC_NPROCESSORS_ONLN);
+  return quantidade > 0 ? (int)quantidade : 1;
+}
+
+void adicionarLista(sat_lista_t* lista, size_t item) {
+  if (lista->tamanho == lista->capacidade) {
+    lista->capacidade = lista->capacidade > 0 ? 2 * lista->capacidade : 4;
+    lista->itens = realocar(lista->itens, lista->capacidade * sizeof(size_t));
+  }
+  lista->itens[lista->tamanho++] = item;
+}
+
+void removerLista(sat_lista_t* lista, size_t item) {
+  for (int i = 0; i < lista->tamanho; i++) {
+    if (lista->itens[i] == item) {
+      lista->itens[i] = lista->itens[--lista->tamanho];
+      return;
+    }
+  }
+}
+
+bool removida(const sat_pre_t* pre, size_t clausula) {
+  return pre->clausulas.dados[clausula + 1] == CLAUSULA_REMOVIDA;
+}
+
+void tocarClausula(sat_pre_t* pre, size_t clausula) {
+  int* literais = literaisClausula(&pre->clausulas, clausula);
+  for (int i = 0; i < tamanhoClausula(&pre->clausulas, clausula); i++) {
+    pre->tocadas[variavel(literais[i])] = true;
+  }
+}
+
+void removerClausula(sat_pre_t* pre, size_t clausula) {
+  tocarClausula(pre, clausula);
+  pre->clausulas.dados[clausula + 1] = CLAUSULA_REMOVIDA;
+}
+
+void enfileirar(sat_pre_t* pre, size_t clausula) {
+  if (pre->clausulas.dados[clausula + 1] != 0) return;
+  pre->clausulas.dados[clausula + 1] = CLAUSULA_NA_FILA;
+  adicionarLista(&pre->fila, clausula);
+}
+
+int contarOcorrencias(sat_pre_t* pre, int literal) {
+  sat_lista_t* lista = &pre->ocorrencias[indiceLiteral(literal)];
+  int mantidas = 0;
+  for (int i = 0; i < lista->tamanho; i++) {
+    if (!removida(pre, lista->itens[i])) {
+      lista->itens[mantidas++] = lista->itens[i];
+    }
+  }
+  lista->tamanho = mantidas;
+  return mantidas;
+}
+
+int valorPre(const sat_pre_t* pre, int literal) {
+  int valor = pre->valores[variavel(literal)];
+  return literal > 0 ? valor : -valor;
+}
+
+bool fixar(sat_pre_t* pre, int literal) {
+  int valor = valorPre(pre, literal);
+  if (valor != 0) return valor > 0;
+
+  pre->valores[variavel(literal)] = literal > 0 ? 1 : -1;
+  pre->unitarias[pre->qtdUnitarias++] = literal;
+  return true;
+}
+
+int limparClausula(sat_pre_t* pre, const int* literais, int tamanho,
+                   int* destino) {
+  int tamanhoLimpo = 0;
+  pre->marca++;
+  for (int i = 0; i < tamanho; i++) {
+    int indice = indiceLiteral(literais[i]);
+    if (pre->marcas[indice ^ 1] == pre->marca) return -1;
+    if (pre->marcas[indice] != pre->marca) {
+      pre->marcas[indice] = pre->marca;
+      destino[tamanhoLimpo++] = literais[i];
+    }
+  }
+  return tamanhoLimpo;
+}
+
+bool novaClausula(sat_pre_t* pre, int* literais, int tamanho) {
+  int livres = 0;
+  for (int i = 0; i < tamanho; i++) {
+    int valor = valorPre(pre, literais[i]);
+    if (valor > 0) return true;
+    if (valor == 0) literais[livres++] = literais[i];
+  }
+
+  if (livres == 0) return false;
+  if (livres == 1) return fixar(pre, literais[0]);
+
+  size_t clausula = adicionarClausula(&pre->clausulas, literais, livres, 0);
+  adicionarLista(&pre->todas, clausula);
+  for (int i = 0; i < livres; i++) {
+    adicionarLista(&pre->ocorrencias[indiceLiteral(literais[i])], clausula);
+  }
+  tocarClausula(pre, clausula);
+  enfileirar(pre, clausula);
+  return true;
+}
+
+bool fortalecer(sat_pre_t* pre, size_t clausula, int literal) {
+  int* literais = literaisClausula(&pre->clausulas, clausula);
+  int tamanho = tamanhoClausula(&pre->clausulas, clausula);
+  for (int i = 0; i < tamanho; i++) {
+    if (literais[i] == literal) {
+      literais[i] = literais[--tamanho];
+      break;
+    }
+  }
+  pre->clausulas.dados[clausula] = tamanho;
+  removerLista(&pre->ocorrencias[indiceLiteral(literal)], clausula);
+  pre->tocadas[variavel(literal)] = true;
+  tocarClausula(pre, clausula);
+
+  if (tamanho == 1) {
+    removerClausula(pre, clausula);
+    return fixar(pre, literais[0]);
+  }
+  enfileirar(pre, clausula);
+  return true;
+}
+
+bool propagarPre(sat_pre_t* pre) {
+  while (pre->propagadas < pre->qtdUnitarias) {
+    int literal = pre->unitarias[pre->propagadas++];
+    sat_lista_t* verdadeiras = &pre->ocorrencias[indiceLiteral(literal)];
+    for (int i = 0; i < verdadeiras->tamanho; i++) {
+      removerClausula(pre, verdadeiras->itens[i]);
+    }
+    verdadeiras->tamanho = 0;
+
+    sat_lista_t falsas = pre->ocorrencias[indiceLiteral(-literal)];
+    pre->ocorrencias[indiceLiteral(-literal)] = (sat_lista_t){NULL, 0, 0};
+    bool consistente = true;
+    for (int i = 0; i < falsas.tamanho && consistente; i++) {
+      if (!removida(pre, falsas.itens[i])) {
+        consistente = fortalecer(pre, falsas.itens[i], -literal);
+      }
+    }
+    free(falsas.itens);
+    if (!consistente) return false;
+  }
+  return true;
+}
+
+bool subsumir(sat_pre_t* pre, size_t clausula) {
+  int* literais = literaisClausula(&pre->clausulas, clausula);
+  int tamanho = tamanhoClausula(&pre->clausulas, clausula);
+  int escolhido = literais[0];
+  int menor = INT_MAX;
+  for (int i = 0; i < tamanho; i++) {
+    int ocorrencias = pre->ocorrencias[indiceLiteral(literais[i])].tamanho +
+                      pre->ocorrencias[indiceLiteral(-literais[i])].tamanho;
+    if (ocorrencias < menor) {
+      menor = ocorrencias;
+      escolhido = literais[i];
+    }
+  }
+
+  pre->marca++;
+  for (int i = 0; i < tamanho; i++) {
+    pre->marcas[indiceLiteral(literais[i])] = pre->marca;
+  }
+
+  pre->candidatos.tamanho = 0;
+  for (int sinal = 1; sinal >= -1; sinal -= 2) {
+    sat_lista_t* lista = &pre->ocorrencias[indiceLiteral(sinal * escolhido)];
+    for (int i = 0; i < lista->tamanho; i++) {
+      adicionarLista(&pre->candidatos, lista->itens[i]);
+    }
+  }
+
+  for (int i = 0; i < pre->candidatos.tamanho; i++) {
+    size_t outra = pre->candidatos.itens[i];
+    if (outra == clausula || removida(pre, outra) ||
+        tamanhoClausula(&pre->clausulas, outra) < tamanho) {
+      continue;
+    }
+
+    int* outros = literaisClausula(&pre->clausulas, outra);
+    int iguais = 0, invertidos = 0, invertido = 0;
+    for (int k = 0; k < tamanhoClausula(&pre->clausulas, outra); k++) {
+      int indice = indiceLiteral(outros[k]);
+      if (pre->marcas[indice] == pre->marca) {
+        iguais++;
+      } else if (pre->marcas[indice ^ 1] == pre->marca) {
+        invertidos++;
+        invertido = outros[k];
+      }
+    }
+
+    if (iguais + invertidos != tamanho || invertidos > 1) continue;
+    if (invertidos == 0) {
+      removerClausula(pre, outra);
+    } else if (!fortalecer(pre, outra, invertido)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool esvaziarFila(sat_pre_t* pre) {
+  while (pre->fila.tamanho > 0) {
+    size_t clausula = pre->fila.itens[--pre->fila.tamanho];
+    if (removida(pre, clausula)) continue;
+
+    pre->clausulas.dados[clausula + 1] = 0;
+    if (!subsumir(pre, clausula) || !propagarPre(pre)) return false;
+  }
+  return propagarPre(pre);
+}
+
+bool eliminarPuros(sat_pre_t* pre) {
+  for (int var = 0; var < pre->qtdVariaveis; var++) {
+    if (pre->valores[var] != 0) continue;
+
+    int positivos = contarOcorrencias(pre, var + 1);
+    int negativos = contarOcorrencias(pre, -(var + 1));
+    if (positivos + negativos > 0 && (positivos == 0 || negativos == 0)) {
+      fixar(pre, negativos == 0 ? var + 1 : -(var + 1));
+      if (!propagarPre(pre)) return false;
+    }
+  }
+  return true;
+}
+
+int resolver(sat_pre_t* pre, size_t positiva, size_t negativa, int var) {
+  int tamanho = 0;
+  pre->marca++;
+  size_t clausulas[] = {positiva, negativa};
+  for (int lado = 0; lado < 2; lado++) {
+    int* literais = literaisClausula(&pre->clausulas, clausulas[lado]);
+    for (int i = 0; i < tamanhoClausula(&pre->clausulas, clausulas[lado]);
+         i++) {
+      int indice = indiceLiteral(literais[i]);
+      if (variavel(literais[i]) == var || pre->marcas[indice] == pre->marca) {
+        continue;
+      }
+      if (pre->marcas[indice ^ 1] == pre->marca) return -1;
+      pre->marcas[indice] = pre->marca;
+      pre->resolvente[tamanho++] = literais[i];
+    }
+  }
+  return tamanho;
+}
+
+void guardarClausula(sat_pre_t* pre, size_t clausula, int pivo) {
+  int* literais = literaisClausula(&pre->clausulas, clausula);
+  int tamanho = tamanhoClausula(&pre->clausulas, clausula);
+  for (int i = 0; i < tamanho; i++) {
+    if (literais[i] == pivo) {
+      literais[i] = literais[0];
+      literais[0] = pivo;
+    }
+  }
+  adicionarClausula(&pre->reconstrucao, literais, tamanho, 0);
+  removerClausula(pre, clausula);
+}
+
+bool eliminarVariavel(sat_pre_t* pre, int var) {
+  int literal = var + 1;
+  int positivos = contarOcorrencias(pre, literal);
+  int negativos = contarOcorrencias(pre, -literal);
+  if (positivos + negativos == 0) return true;
+  if (positivos > LIMITE_OCORRENCIAS && negativos > LIMITE_OCORRENCIAS) {
+    return true;
+  }
+
+  sat_lista_t* listaPositiva = &pre->ocorrencias[indiceLiteral(literal)];
+  sat_lista_t* listaNegativa = &pre->ocorrencias[indiceLiteral(-literal)];
+  int resolventes = 0;
+  for (int i = 0; i < positivos; i++) {
+    for (int k = 0; k < negativos; k++) {
+      int tamanho = resolver(pre, listaPositiva->itens[i],
+                             listaNegativa->itens[k], var);
+      if (tamanho < 0) continue;
+      resolventes++;
+      if (tamanho > LIMITE_RESOLVENTE || resolventes > positivos + negativos) {
+        return true;
+      }
+    }
+  }
+
+  for (int i = 0; i < positivos; i++) {
+    guardarClausula(pre, listaPositiva->itens[i], literal);
+  }
+  for (int k = 0; k < negativos; k++) {
+    guardarClausula(pre, listaNegativa->itens[k], -literal);
+  }
+  pre->eliminadas[var] = true;
+
+  bool consistente = true;
+  for (int i = 0; i < positivos && consistente; i++) {
+    for (int k = 0; k < negativos && consistente; k++) {
+      int tamanho = resolver(pre, listaPositiva->itens[i],
+                             listaNegativa->itens[k], var);
+      if (tamanho >= 0) {
+        consistente = novaClausula(pre, pre->resolvente, tamanho);
+      }
+    }
+  }
+  listaPositiva->tamanho = 0;
+  listaNegativa->tamanho = 0;
+  return consistente && esvaziarFila(pre);
+}
 
-  liberarArvore(raiz->esquerda);
-  liberarArvore(raiz->direita);
+bool eliminarVariaveis(sat_pre_t* pre) {
+  sat_ocorrencia_t* ordem =
+      alocar((pre->qtdVariaveis + 1) * sizeof(sat_ocorrencia_t));
+  bool consistente = true;
+  bool mudou = true;
+  while (mudou && consistente) {
+    mudou = false;
+    int qtdCandidatas = 0;
+    for (int var = 0; var < pre->qtdVariaveis; var++) {
+      if (!pre->tocadas[var]) continue;
+      pre->tocadas[var] = false;
+      int ocorrencias = pre->ocorrencias[2 * var].tamanho +
+                        pre->ocorrencias[2 * var + 1].tamanho;
+      ordem[qtdCandidatas++] = (sat_ocorrencia_t){ocorrencias, var};
+    }
+    qsort(ordem, qtdCandidatas, sizeof(sat_ocorrencia_t),
+          compararOcorrencias);
 
-  free(raiz);
+    for (int i = qtdCandidatas - 1; i >= 0 && consistente; i--) {
+      int var = ordem[i].var;
+      if (pre->valores[var] != 0 || pre->eliminadas[var]) continue;
+      consistente = eliminarVariavel(pre, var);
+      mudou = mudou || pre->eliminadas[var];
+    }
+  }
+  free(ordem);
+  return consistente;
 }
 
-void liberarCNF(sat_cnf_t* cnf) {
-  for (int i = 0; i < cnf->qtdClausulas; i++) {
-    free(cnf->clausulas[i]);
+bool preprocessar(sat_pre_t* pre, const sat_cnf_t* cnf,
+                  sat_cnf_t* simplificada) {
+  int n = cnf->qtdVariaveis;
+  memset(pre, 0, sizeof(sat_pre_t));
+  memset(simplificada, 0, sizeof(sat_cnf_t));
+  pre->qtdVariaveis = n;
+  pre->ocorrencias = calloc(2 * n + 2, sizeof(sat_lista_t));
+  pre->valores = calloc(n + 1, sizeof(signed char));
+  pre->eliminadas = calloc(n + 1, sizeof(bool));
+  pre->tocadas = calloc(n + 1, sizeof(bool));
+  pre->unitarias = calloc(n + 1, sizeof(int));
+  pre->marcas = calloc(2 * n + 2, sizeof(long));
+  pre->resolvente = calloc(n + 1, sizeof(int));
+  if (!pre->ocorrencias || !pre->valores || !pre->eliminadas ||
+      !pre->tocadas || !pre->unitarias || !pre->marcas || !pre->resolvente) {
+    fprintf(stderr, "Erro: memória insuficiente\n");
+    exit(EXIT_FAILURE);
+  }
+  reservarArena(&pre->clausulas, cnf->arena.tamanho);
+
+  const sat_arena_t* arena = &cnf->arena;
+  for (size_t c = 0; c < arena->tamanho; c = proximaClausula(arena, c)) {
+    int* literais = literaisClausula(arena, c);
+    for (int i = 0; i < tamanhoClausula(arena, c); i++) {
+      pre->ocorrencias[indiceLiteral(literais[i])].capacidade++;
+    }
+  }
+  for (int i = 0; i < 2 * n + 2; i++) {
+    sat_lista_t* lista = &pre->ocorrencias[i];
+    if (lista->capacidade > 0) {
+      lista->itens = alocar(lista->capacidade * sizeof(size_t));
+    }
+  }
+
+  bool consistente = true;
+  for (size_t c = 0; c < arena->tamanho && consistente;
+       c = proximaClausula(arena, c)) {
+    int tamanho = limparClausula(pre, literaisClausula(arena, c),
+                                 tamanhoClausula(arena, c), pre->resolvente);
+    if (tamanho >= 0) {
+      consistente = novaClausula(pre, pre->resolvente, tamanho);
+    }
+  }
+
+  consistente = consistente && propagarPre(pre) && esvaziarFila(pre) &&
+                eliminarPuros(pre) && eliminarVariaveis(pre);
+  if (!consistente) return false;
+
+  int* novas = calloc(n + 1, sizeof(int));
+  pre->originais = calloc(n + 1, sizeof(int));
+  if (!novas || !pre->originais) {
+    fprintf(stderr, "Erro: memória insuficiente\n");
+    exit(EXIT_FAILURE);
   }
+  for (int i = 0; i < pre->todas.tamanho; i++) {
+    size_t c = pre->todas.itens[i];
+    if (removida(pre, c)) continue;
 
-  free(cnf->clausulas);
-  free(cnf->tamanhos);
+    int* literais = literaisClausula(&pre->clausulas, c);
+    int tamanho = tamanhoClausula(&pre->clausulas, c);
+    for (int k = 0; k < tamanho; k++) {
+      int var = variavel(literais[k]);
+      if (novas[var] == 0) {
+        pre->originais[simplificada->qtdVariaveis] = var;
+        novas[var] = ++simplificada->qtdVariaveis;
+      }
+      pre->resolvente[k] = literais[k] > 0 ? novas[var] : -novas[var];
+    }
+    adicionarClausula(&simplificada->arena, pre->resolvente, tamanho, 0);
+    simplificada->qtdClausulas++;
+  }
+  free(novas);
+  return true;
 }
 
-int main() {
+void reconstruirModelo(const sat_pre_t* pre, const sat_cnf_t* simplificada,
+                       const bool* simplificados, bool* valores) {
+  for (int var = 0; var < pre->qtdVariaveis; var++) {
+    valores[var] = pre->valores[var] > 0;
+  }
+  for (int var = 0; var < simplificada->qtdVariaveis; var++) {
+    valores[pre->originais[var]] = simplificados[var];
+  }
+
+  const sat_arena_t* pilha = &pre->reconstrucao;
+  size_t qtdClausulas = 0;
+  for (size_t c = 0; c < pilha->tamanho; c = proximaClausula(pilha, c)) {
+    qtdClausulas++;
+  }
+  size_t* inicios = alocar((qtdClausulas + 1) * sizeof(size_t));
+  qtdClausulas = 0;
+  for (size_t c = 0; c < pilha->tamanho; c = proximaClausula(pilha, c)) {
+    inicios[qtdClausulas++] = c;
+  }
+
+  while (qtdClausulas > 0) {
+    size_t c = inicios[--qtdClausulas];
+    int* literais = literaisClausula(pilha, c);
+    if (!satisfazClausula(literais, tamanhoClausula(pilha, c), valores)) {
+      valores[variavel(literais[0])] = literais[0] > 0;
+    }
+  }
+  free(inicios);
+}
+
+void liberarPre(sat_pre_t* pre) {
+  for (int i = 0; i < 2 * pre->qtdVariaveis + 2; i++) {
+    free(pre->ocorrencias[i].itens);
+  }
+  free(pre->ocorrencias);
+  free(pre->clausulas.dados);
+  free(pre->todas.itens);
+  free(pre->valores);
+  free(pre->eliminadas);
+  free(pre->tocadas);
+  free(pre->unitarias);
+  free(pre->fila.itens);
+  free(pre->candidatos.itens);
+  free(pre->marcas);
+  free(pre->resolvente);
+  free(pre->reconstrucao.dados);
+  free(pre->originais);
+}
+
+void imprimirModelo(const bool* valores, const sat_cnf_t* cnf) {
+  int qtdImpressas = cnf->qtdVariaveis > cnf->qtdDeclaradas
+                         ? cnf->qtdVariaveis
+                         : cnf->qtdDeclaradas;
+  printf("v");
+  for (int var = 0; var < qtdImpressas; var++) {
+    bool valor = var < cnf->qtdVariaveis && valores[var];
+    printf(" %d", valor ? var + 1 : -(var + 1));
+  }
+  printf(" 0\n");
+}
+
+void liberarCNF(sat_cnf_t* cnf) { free(cnf->arena.dados); }
+
+int main(int argc, char** argv) {
+  const char* nomeArquivo = "exemplo.cnf";
+  int qtdTrabalhadores = qtdNucleos();
+  bool cuboConquista = false;
+  bool preprocessamento = true;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+      qtdTrabalhadores = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--cubos") == 0) {
+      cuboConquista = true;
+    } else if (strcmp(argv[i], "--sem-preprocessamento") == 0) {
+      preprocessamento = false;
+    } else {
+      nomeArquivo = argv[i];
+    }
+  }
+  if (qtdTrabalhadores < 1) {
+    fprintf(stderr, "Erro: número de threads inválido\n");
+    return EXIT_FAILURE;
+  }
+
   sat_cnf_t cnf;
-  lerCNF("exemplo.cnf", &cnf);
+  if (!lerCNF(nomeArquivo, &cnf)) return EXIT_FAILURE;
 
-  bool* valores = calloc(cnf.qtdVariaveis, sizeof(bool));
-  sat_no_t* raiz = construirArvore(0, cnf.qtdVariaveis);
+  bool* valores = calloc(cnf.qtdVariaveis + 1, sizeof(bool));
+  bool satisfeita;
+  if (preprocessamento) {
+    sat_pre_t pre;
+    sat_cnf_t simplificada;
+    satisfeita = preprocessar(&pre, &cnf, &simplificada);
+    bool* simplificados = calloc(simplificada.qtdVariaveis + 1, sizeof(bool));
+    satisfeita = satisfeita && resolverCNF(&simplificada, simplificados,
+                                           qtdTrabalhadores, cuboConquista);
+    if (satisfeita) {
+      reconstruirModelo(&pre, &simplificada, simplificados, valores);
+    }
+    free(simplificados);
+    liberarCNF(&simplificada);
+    liberarPre(&pre);
+  } else {
+    satisfeita = resolverCNF(&cnf, valores, qtdTrabalhadores, cuboConquista);
+  }
 
-  if (avaliarArvore(raiz, &cnf, valores)) {
+  int codigo = EXIT_SUCCESS;
+  if (satisfeita && !verificaCNF(&cnf, valores)) {
+    fprintf(stderr, "Erro interno: modelo não satisfaz a fórmula\n");
+    codigo = EXIT_FAILURE;
+  } else if (satisfeita) {
     printf("\nSAT\n");
+    imprimirModelo(valores, &cnf);
   } else {
     printf("\nUNSAT\n");
   }
 
-  liberarArvore(raiz);
   free(valores);
   liberarCNF(&cnf);
-  return 0;
-}
\ No newline at end of file
+  return codigo;
+}